@@ -0,0 +1,186 @@
+# Copyright (c) 2021 Olle Lögdahl
+#
+# This software is released under the MIT License.
+# https://opensource.org/licenses/MIT
+
+# Benchmarks the compiler on the programs in bench/: the time spent in each
+# phase of compiling them, the size of the executables and how long those
+# run. Every measurement is the best of BENCH_RUNS runs.
+#
+# The results are compared against a saved baseline, and the script fails
+# if anything got more than BENCH_THRESHOLD percent worse. Times below
+# BENCH_FLOOR seconds are too noisy to compare and are only reported.
+
+# usage: bench/bench.sh out/bfc
+#   BENCH_RUNS=n          runs per measurement (default 5).
+#   BENCH_BASELINE=file   the baseline to compare with (default
+#                         bench/baseline.txt).
+#   BENCH_SAVE=1          saves the results as the new baseline instead.
+#   BENCH_THRESHOLD=p     the allowed regression in percent (default 15).
+#   BENCH_FLOOR=s         the smallest time compared (default 0.01).
+
+BFC=$1
+DIR=$(dirname "$0")
+
+RUNS=${BENCH_RUNS:-5}
+BASELINE=${BENCH_BASELINE:-$DIR/baseline.txt}
+THRESHOLD=${BENCH_THRESHOLD:-15}
+FLOOR=${BENCH_FLOOR:-0.01}
+
+[ -x "$BFC" ] || { echo "${BFC}: cannot execute"; exit 1; }
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# the programs with the input they run with, which sets how often they
+# repeat themselves. mandel reads no input. large is generated, and only
+# compiled, as it has no input after its name.
+PROGRAMS="factor:\050 mandel: hanoi:\377 sieve:\050\050 large"
+
+# writes a large program of random straight-line code and multiplication
+# loops, the same every time. It starts with a read so that it can not be
+# evaluated at compile time.
+gen_large() {
+    awk 'BEGIN {
+        seed = 1
+        printf ","
+        for(unit = 0; unit < 200000; unit++) {
+            r = rand31() % 8
+            if(r < 5) {
+                n = 1 + rand31() % 8
+                c = substr("+-<>", 1 + rand31() % 4, 1)
+                for(i = 0; i < n; i++) printf "%s", c
+            } else if(r < 7) {
+                printf "[-"
+                mul(1 + rand31() % 4, r == 6)
+                printf "]"
+            } else {
+                printf "."
+            }
+            if(unit % 16 == 15) printf "\n"
+        }
+        printf "\n"
+    }
+    function rand31() {
+        seed = (seed * 1103515245 + 12345) % 2147483648
+        return int(seed / 65536)
+    }
+    # adds multiples of the counter to cells to its right, each visited
+    # once, optionally through a nested loop on one of them.
+    function mul(n, nested,    i, k) {
+        for(i = 1; i <= n; i++) {
+            printf ">"
+            for(k = rand31() % 5; k >= 0; k--) printf "+"
+        }
+        if(nested) printf "[->+<]"
+        for(i = 1; i <= n; i++) printf "<"
+    }' > "$1"
+}
+
+# the current time in seconds. POSIX date has no fractions of a second,
+# so this needs the %N of GNU date.
+now() {
+    date +%s.%N
+}
+case $(now) in
+*N*) echo "date does not support %N, cannot time runs"; exit 1 ;;
+esac
+
+# runs a program on an input BENCH_RUNS times and prints the best time.
+best_time() {
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        START=$(now)
+        "$1" < "$2" > /dev/null
+        END=$(now)
+        echo "$START $END" | awk '{ printf "%.3f\n", $2 - $1 }'
+        i=$((i+1))
+    done | sort -n | head -n 1
+}
+
+RESULTS="$TMPDIR/results"
+: > "$RESULTS"
+
+# lowering the tokens to instructions counts as optimizing them.
+printf "%-8s %10s %10s %10s %10s %10s %10s %8s\n" \
+    program tokenize optimize evaluate emit compile size run
+
+for SPEC in $PROGRAMS; do
+    NAME=${SPEC%%:*}
+    INPUT=
+    RUN=-
+    case $SPEC in
+    *:*) INPUT=${SPEC#*:}; RUN= ;;
+    esac
+
+    SRC="$DIR/$NAME.b"
+    [ "$NAME" = large ] && { SRC="$TMPDIR/large.b"; gen_large "$SRC"; }
+
+    # the best time of every phase, over all the compiles.
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        "$BFC" -x -ftime-report -o "$TMPDIR/$NAME" "$SRC" 2>> "$TMPDIR/$NAME.times" \
+            || { echo "$NAME: failed to compile"; exit 1; }
+        i=$((i+1))
+    done
+    PHASES=$(awk '
+        !($1 in best) || $2 < best[$1] { best[$1] = $2 }
+        END {
+            optimize = best["lower"] + best["optimize"]
+            printf "%.6f %.6f %.6f %.6f %.6f", best["tokenize"], optimize, best["evaluate"], best["emit"], best["total"]
+        }' "$TMPDIR/$NAME.times")
+
+    SIZE=$(wc -c < "$TMPDIR/$NAME" | tr -d ' ')
+
+    if [ "$RUN" != - ]; then
+        printf "$INPUT" > "$TMPDIR/$NAME.in"
+        "$TMPDIR/$NAME" < "$TMPDIR/$NAME.in" > /dev/null \
+            || { echo "$NAME: failed to run"; exit 1; }
+        RUN=$(best_time "$TMPDIR/$NAME" "$TMPDIR/$NAME.in")
+    fi
+
+    set -- $PHASES
+    printf "%-8s %10s %10s %10s %10s %10s %10s %8s\n" "$NAME" "$1" "$2" "$3" "$4" "$5" "$SIZE" "$RUN"
+    {
+        echo "$NAME tokenize $1"
+        echo "$NAME optimize $2"
+        echo "$NAME evaluate $3"
+        echo "$NAME emit $4"
+        echo "$NAME compile $5"
+        echo "$NAME size $SIZE"
+        [ "$RUN" = - ] || echo "$NAME run $RUN"
+    } >> "$RESULTS"
+done
+
+if [ -n "$BENCH_SAVE" ]; then
+    cp "$RESULTS" "$BASELINE"
+    echo "saved the baseline to $BASELINE."
+    exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+    echo "no baseline at $BASELINE, save one with BENCH_SAVE=1."
+    exit 0
+fi
+
+echo
+awk -v threshold="$THRESHOLD" -v floor="$FLOOR" '
+    NR == FNR { base[$1 " " $2] = $3; next }
+    {
+        key = $1 " " $2
+        if(!(key in base)) next
+        old = base[key]; new = $3
+        if($2 != "size" && old < floor && new < floor) next
+
+        change = (old > 0) ? (new - old) * 100 / old : 0
+        if(change > threshold) {
+            printf "regression: %-18s %10s -> %10s (%+.1f%%)\n", key, old, new, change
+            failed = 1
+        } else if(change < -threshold) {
+            printf "improvement: %-17s %10s -> %10s (%+.1f%%)\n", key, old, new, change
+        }
+    }
+    END {
+        if(failed) exit 1
+        printf "no regressions over %s%% against the baseline.\n", threshold
+    }' "$BASELINE" "$RESULTS"
@@ -0,0 +1,62 @@
+factor: factors every number from 2 to 255 into primes
+and prints one line per number like 12: 2 2 3
+
+the whole program runs as many times as the first input byte says
+so that none of it can be evaluated at compile time
+
+>>>>>>>[-],[<<<<<<<[-]++>>>>>>[-]--[>>[-]++++++++++>>>>>[-]>>>>>>>>[-]<<
+<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>+>>>>>>>>+<<<<<<<<<<<<<<<<<<<<<]>>>>>>
+>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]<<<<<<<[-]>
+>>>>>>[-]<<<<<<<<<<<<<[->>>>>>+>>>>>>>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<
+<<<<<<<<<+>>>>>>>>>>>>>]<<<<<<<<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<[-]>>>>
+>>>>>>>[-]<<<<<<[-<<<<<+>>>>>>>>>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<<<<<
+<<<<<[-]>>>>>>>>>>>>[-]<<<<<[-<<<<<<<+>>>>>>>>>>>>+<<<<<]>>>>>[-<<<<<+>>
+>>>]<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]<<<<<[-]>>>>>>>>[-]<<<<<<<<<<<<[->>>>
++>>>>>>>>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<[-
+]>>>>>>>[-]<<<<<<<<<<<<<[->>>>>>+>>>>>>>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<
+<<<<<<<<<<<+>>>>>>>>>>>>>]<<<<<<<<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<[-]>>>>
+>>>>>[-]<<<<<<[-<<<+>>>>>>>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<<<<<<<<[-]
+>>>>>>>>>>[-]<<<<<[-<<<<<+>>>>>>>>>>+<<<<<]>>>>>[-<<<<<+>>>>>]<<<<<<<<[-
+]>[-]>[-]>[-]>[-]>[-]>>>[-]>[-]<<<<<<<<<<<[->>>>>>>>>>+>+<<<<<<<<<<<]>>>
+>>>>>>>>[-<<<<<<<<<<<+>>>>>>>>>>>]<[<<<<<<<<<<++++++++++++++++++++++++++
+++++++++++++++++++++++.------------------------------------------------>
+>>>>>>>>>[-]][-]>[-]<<<<<<<<<<<<<[->>>>>>>>>>>>+>+<<<<<<<<<<<<<]>>>>>>>>
+>>>>>[-<<<<<<<<<<<<<+>>>>>>>>>>>>>]<[<<<<<<<<<++++++++++++++++++++++++++
+++++++++++++++++++++++.------------------------------------------------>
+>>>>>>>>[-]]<<<<<<<<<<<++++++++++++++++++++++++++++++++++++++++++++++++.
+<<[-]>[-]>[-]>[-]>[-][-]++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++.[-]<<<<<<<<<<<[-]>>>>>>>>>>>[-]<<<<<<<<<<<<[->+>>>>>>>>>>>+<<
+<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<<<<[-]++>>>[-]
+>>>>>>>[-]<<<<<<<<<<<[->>>>+>>>>>>>+<<<<<<<<<<<]>>>>>>>>>>>[-<<<<<<<<<<<
++>>>>>>>>>>>]<<<<<<<-[>>>>>>>>[-]<[-]<<<<<<<<<<<[->>>>>>>>>>>>+<+<<<<<<<
+<<<<]>>>>>>>>>>>[-<<<<<<<<<<<+>>>>>>>>>>>]>>[-]<<[-]<<<<<<<<<<[->>>>>>>>
+>>>>+<<+<<<<<<<<<<]>>>>>>>>>>[-<<<<<<<<<<+>>>>>>>>>>]>[->-[>+>>]>[+[-<+>
+]>+>>]<<<<<]<<<<<<<<<[-]>>>>>>>>[-]>>>[-<<<<<<<<<<<+>>>>>>>>+>>>]<<<[->>
+>+<<<]<<<<<<<<<[-]>>>>>>>>>[-]>>>>[-<<<<<<<<<<<<<+>>>>>>>>>+>>>>]<<<<[->
+>>>+<<<<]>[-]>[-]>[-]>[-]>[-]>[-]<<<<<<[-]+<[-]<[-]<<<<<<[->>>>>>>+<+<<<
+<<<]>>>>>>[-<<<<<<+>>>>>>]>[<<<<<<<<<+>>>>>>>>>>[-]<[-]]>[<<[-]+++++++++
++++++++++++++++++++++++.[-][-]++++++++++>>>[-]>>>>>>>>>>[-]<<<<<<<<<<<<<
+<<<<<<<<[->>>>>>>>>>>+>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>
+>>>>[-<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]<<<<<<<<<[-]>>>>>>>>>[
+-]<<<<<<<<<<<<<[->>>>+>>>>>>>>>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<
+<<+>>>>>>>>>>>>>]<<<<<<<<<<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<[-]>>>>>>>
+>>>>>>>>[-]<<<<<<<<[-<<<<<<<+>>>>>>>>>>>>>>>+<<<<<<<<]>>>>>>>>[-<<<<<<<<
++>>>>>>>>]<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>[-]<<<<<<<[-<<<<<<<+>>>>>>>>>>>
+>>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]<<
+<<<[-]>>>>>>>>>>[-]<<<<<<<<<<<<<<[->>>>+>>>>>>>>>>+<<<<<<<<<<<<<<]>>>>>>
+>>>>>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<<<<<<<<<[-]>>>>>>>>>[-]<<<<<<<<
+<<<<<[->>>>+>>>>>>>>>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>>>>>>
+>>>>>>]<<<<<<<<<<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]>>>>>>>>>[-]>[-]<<<<<<<<[
+->>>>>>>+>+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<[-]>>[-]<<<<<<<[->>>>>
++>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]>>
+>>>[-]>[-]<<<[->>+>+<<<]>>>[-<<<+>>>]<[<<+++++++++++++++++++++++++++++++
++++++++++++++++++.------------------------------------------------>>[-]]
+[-]>[-]<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>
+[-<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]<[<+++++++++++++++++++++++++++++++++++
++++++++++++++.------------------------------------------------>[-]]<<<<<
+<<<<<<<<<<++++++++++++++++++++++++++++++++++++++++++++++++.>>[-]<[-]<[-]
+>>>>>>>>>>>>>[-]>[-]<<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>>>>>[-]<<<<
+<<<<<<<<<<<<<<<[-<<+>>>>>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>
+>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<<<<<<<<<<[-]]<<<<<<<
+[-]>>>>>>[-]<<<<<<<<<<[->>>>+>>>>>>+<<<<<<<<<<]>>>>>>>>>>[-<<<<<<<<<<+>>
+>>>>>>>>]<<<<<<-]>>>>>>[-]++++++++++.[-]<<<<<<<<<<<+>>>>>>-]>-]
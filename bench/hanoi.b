@@ -0,0 +1,86 @@
+hanoi: prints the 255 moves that solve the towers of Hanoi
+with 8 disks
+
+the whole program runs as many times as the first input byte says
+so that none of it can be evaluated at compile time
+
+>>>>>>>>>>>>>>[-],[<<<<<<<[-]++>[-]+++<<<<<<<<[-]+>[-]-[>[-]>>>>>>>>>>>>
+>[-]<<<<<<<<<<<<<<<[->>+>>>>>>>>>>>>>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>[-<
+<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]<<<<<<<<<<<<[-]>>>>>>>>>>>>>[-]<[-]<<<<<<
+<<<<<<<[->>>>>>>>>>>>>>+<+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>>
+>>>>>>>>>>]>>[-]<<[-]<<<<<<<<[->>>>>>>>>>+<<+<<<<<<<<]>>>>>>>>[-<<<<<<<<
++>>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<<<<<<[-]>>>>>>>>>[-]>>>[-<
+<<<<<<<<<<<+>>>>>>>>>+>>>]<<<[->>>+<<<]<<<<<<<<<<[-]>>>>>>>>>>[-]>>>>[-<
+<<<<<<<<<<<<<+>>>>>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>[-]>[-]>[-]>[-]<<
+<<<<<<<<<<<<<<<[-]+>>>>>>>>>>>[-]<<<<<<<<<[-<<->>>>>>>>>>>+<<<<<<<<<]>>>
+>>>>>>[-<<<<<<<<<+>>>>>>>>>]<<<<<<<<<<[-]>[-]<<[>>>>>>>>>>>>[-]<[-]<<<<<
+<<<<<<<<[->>>>>>>>>>>>>>+<+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>
+>>>>>>>>>>>]>>[-]<<[-]<<<<<<<<[->>>>>>>>>>+<<+<<<<<<<<]>>>>>>>>[-<<<<<<<
+<+>>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<<<<<<[-]>>>>>>>>>[-]>>>[-
+<<<<<<<<<<<<+>>>>>>>>>+>>>]<<<[->>>+<<<]<<<<<<<<<<[-]>>>>>>>>>>[-]>>>>[-
+<<<<<<<<<<<<<<+>>>>>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>[-]>[-]>[-]>[-]<
+<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>[-]<<<<<<<<<<[-<<<+>>>>>>>>>>>>>+<<<<<
+<<<<<]>>>>>>>>>>[-<<<<<<<<<<+>>>>>>>>>>]<<<<<<<<<<[-]>[-]<<<+>>>>>>>>>>>
+>>[-]<[-]<<<<<<<<<<<<<[->>>>>>>>>>>>>>+<+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<
+<<<<<<<<<<<+>>>>>>>>>>>>>]>>[-]<<[-]<<<<<<<<[->>>>>>>>>>+<<+<<<<<<<<]>>>
+>>>>>[-<<<<<<<<+>>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<<<<<<[-]>>>
+>>>>>>[-]>>>[-<<<<<<<<<<<<+>>>>>>>>>+>>>]<<<[->>>+<<<]<<<<<<<<<<[-]>>>>>
+>>>>>[-]>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>[-
+]>[-]>[-]>[-]<<<<<<<<<<<<<<<<<[-]+>>>>>>>>>>>[-]<<<<<<<<<[-<<->>>>>>>>>>
+>+<<<<<<<<<]>>>>>>>>>[-<<<<<<<<<+>>>>>>>>>]<<<<<<<<<<[-]>[-]<<]>>>>>>>>>
+>>>[-]<[-]<<<<<<<<<<<<<[->>>>>>>>>>>>>>+<+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<
+<<<<<<<<<<<<+>>>>>>>>>>>>>]>>[-]<<[-]<<<<<<<<[->>>>>>>>>>+<<+<<<<<<<<]>>
+>>>>>>[-<<<<<<<<+>>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<<<<<<[-]>>
+>>>>>>>[-]>>>[-<<<<<<<<<<<<+>>>>>>>>>+>>>]<<<[->>>+<<<]<<<<<<[-]>>>>>>[-
+]>>>>[-<<<<<<<<<<+>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>[-]>[-]>[-]>[-]<<
+<<<<<<<<<<<<<[-]>>>>>>>>>>[-]<[-]<<<<<<<<<<<<[->>>>>>>>>>>>>+<+<<<<<<<<<
+<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]>>[-]<<[-]<<<<<<<<[->>>>>>>>
+>>+<<+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<
+<]<<<<<<[-]>>>>>[-]>>>[-<<<<<<<<+>>>>>+>>>]<<<[->>>+<<<]<<<<<<<<<<[-]>>>
+>>>>>>>[-]>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>
+[-]>[-]>[-]>[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>[-]<[-]<<<<<<[->>>>>>>+<+<<
+<<<<]>>>>>>[-<<<<<<+>>>>>>]>>[-]<<[-]<<<<<<<[->>>>>>>>>+<<+<<<<<<<]>>>>>
+>>[-<<<<<<<+>>>>>>>]>[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<<<<<<<[-]>>>>>>>>
+>[-]>>>[-<<<<<<<<<<<<+>>>>>>>>>+>>>]<<<[->>>+<<<]<<<<<<<<<<[-]>>>>>>>>>>
+[-]>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>+>>>>]<<<<[->>>>+<<<<]>[-]>[-]>[-]>[-]
+>[-]>[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>>>[-]+>>>>>>>>>[-]>[-]<<<<<<<<<<<<<<<
+[->>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<+>>>>
+>>>>>>>>>>>]<[<<<<<<<<<<<[-]+++>>>>>>>>>>>>[-]<<<<<<<<<<<<<<<<<<<[->>>>>
+>>->>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<
+<<<<+>>>>>>>>>>>>>>>>>>>]<<<<<<<<<[-]>>>>>>>>>[-]<<<<<<<<<<<<[->>>+>>>>>
+>>>>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<<[-]>>>
+>>>>>[-]<<<<<<<<<<<<<<<<<[->>>>>>>>>+>>>>>>>>+<<<<<<<<<<<<<<<<<]>>>>>>>>
+>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<<<<<<<<<[->-[>+>>]>[+[-<
++>]>+>>]<<<<<]<<<<<[-]>>>>>>>>>>>>>>[-]<<<<<<<[-<<<<<<<+>>>>>>>>>>>>>>+<
+<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>
+>>>[-]<<<<<<[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>+<<<<<<]>>>>>>[-<<<<<<+
+>>>>>>]<<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>[-]>>>
+>>>>>>>>>[-]<<<<<<<<<<<<<<[->>+>>>>>>>>>>>>+<<<<<<<<<<<<<<]>>>>>>>>>>>>>
+>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<<<<<<<<<<<<++>>>[-]>>>>>>>>>[-]<<<<<<<
+<<<<<[->>>+>>>>>>>>>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>
+>]<<<<<<<<[-]>>>>>>>>[-]<<<<<<<<<<<<<<<<<[->>>>>>>>>+>>>>>>>>+<<<<<<<<<<
+<<<<<<<]>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<<<<<<<<<
+[->-[>+>>]>[+[-<+>]>+>>]<<<<<]<<<<[-]>>>>>>>>>>>>>[-]<<<<<<<[-<<<<<<+>>>
+>>>>>>>>>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<<<<<<<<<<<<[-]>>>>>
+>>>>>>>>>>>>>>>[-]<<<<<<[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>+<<<<<<]>>>
+>>>[-<<<<<<+>>>>>>]<<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]<<<<<<<<<<<<<<<<[-]>>
+>>>>>>>>[-]>>>>>>>>>[-]]<<<<<<<<<[<<<<[-]>>>>>>>>>>>>>>[-]<<<<<<<<<<<<<<
+<<<<<[->>>>>+>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>[-<<<
+<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<[-]>>>>>>>>>>>>[-]<<<<<
+<<<<<<<<<[->>+>>>>>>>>>>>>+<<<<<<<<<<<<<<]>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<
++>>>>>>>>>>>>>>]<<<<<<<<<<<<+>>>[-]>>>>>>>>>[-]<<<<<<<<<<<<[->>>+>>>>>>>
+>>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<<[-]>>>>>
+>>>[-]<<<<<<<<<<<<<<<<<[->>>>>>>>>+>>>>>>>>+<<<<<<<<<<<<<<<<<]>>>>>>>>>>
+>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<<<<<<<<<[->-[>+>>]>[+[-<+>
+]>+>>]<<<<<]<<<<[-]>>>>>>>>>>>>>[-]<<<<<<<[-<<<<<<+>>>>>>>>>>>>>+<<<<<<<
+]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>>>>[-]
+<<<<<<[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>
+]<<<<<<<<<[-]>[-]>[-]>[-]>[-]>[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>>>[-]]<<<<<<
+<<<<<<+++++++++++++++++++++++++++++++++++++++++++++++++.>>>>>>>>>>>>>>>>
+>>>>>[-]++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<<<<+++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++.>>>>>>>>>>>>>[-]+++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<<
+<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.>>>>>
+>>>>>>>[-]++++++++++.[-]<<<<<<<<<<<<<<<<<<<<<<[-]>[-]>[-]>>>>>[-]>[-]>[-
+]>[-]>[-]<<<<<<<[-]<<<<<<+>-]>>>>>>>>>>>>>>>>>>>>>>>[-]++++++++++.[-]<<<
+<<<<<<<-]
@@ -1,3 +1,4 @@
+#!/bin/bash
 # Copyright (c) 2021 Olle Lögdahl
 # 
 # This software is released under the MIT License.
@@ -8,6 +9,20 @@
 # if the b file ends with _error it should not be able to compile.
 
 # usage: check.sh out/bfc
+# extra flags for the compiler can be given in BFCFLAGS, and for a single
+# test in a .flags file next to it. BFCRUN can be set
+# to -r or -i to run the programs in the compiler instead of linking them.
+# BFCPROFILE=1 first profiles each program on the input of its first
+# scenario, and builds it with that profile.
+# BFCC can be set to a c compiler and its flags, which then builds the
+# programs from the c written by -femit-c.
+# BFCREPORT=1 builds the programs with -p, and compares the iterations and
+# source ranges of the loops reported on the first scenario with the
+# .report file next to a test, if there is one.
+# BFCBATCH=1 compiles the tests without a .flags file in a single call with
+# -j, along with a file that fails to compile and one without an extension,
+# checks the names of the outputs and that only the failing file stopped,
+# and runs the outputs.
 
 if [ $# -eq 1 ] || [ $2 != "nocolor" ]; then
     ERR=`tput setaf 9`
@@ -24,27 +39,105 @@ TMPDIR=$(mktemp -d)
 TESTS_RAN=0
 SCENARIOS_RAN=0
 
+if [ -n "$BFCBATCH" ]; then
+    BATCH="$TMPDIR/batch"
+    mkdir "$BATCH"
+    for TFILE in tests/*.b ; do
+        [ -f "${TFILE%.*}.flags" ] || cp $TFILE "$BATCH/"
+    done
+    printf "]" > "$BATCH/unmatched.b"
+    printf "++++++++[>+++++++++++++<-]>.+." > "$BATCH/hi"
+    COUNT=$(ls "$BATCH" | wc -l)
+
+    echo -en "batch:\t"
+    $BFC $BFCFLAGS -j 4 "$BATCH"/*.b "$BATCH/hi" 2> "$TMPDIR/log"
+    RC=$?
+
+    # executables have no extension, except for a source without one.
+    case " $BFCFLAGS " in
+    *" -x "*) EXT= ; HI="$BATCH/hi.out" ;;
+    *) EXT=.o ; HI="$BATCH/hi.o" ;;
+    esac
+
+    MISSING=""
+    for TFILE in "$BATCH"/*.b ; do
+        [ "$TFILE" = "$BATCH/unmatched.b" ] && continue
+        [ -f "${TFILE%.*}$EXT" ] || MISSING="$MISSING ${TFILE%.*}$EXT"
+    done
+    [ -f "$HI" ] || MISSING="$MISSING $HI"
+
+    HI_OUT=""
+    if [ -f "$HI" ]; then
+        [ -x "$HI" ] || ld -o "$BATCH/hi.out" "$HI"
+        HI_OUT=$("$BATCH/hi.out")
+    fi
+
+    if [ $RC -eq 0 ] || [ -e "$BATCH/unmatched$EXT" ] || [ -n "$MISSING" ] ||
+        ! grep -q "unmatched.b: unmatched brackets" "$TMPDIR/log" ||
+        ! grep -q "^1 of $COUNT files failed to compile$" "$TMPDIR/log" ||
+        [ "$HI_OUT" != "hi" ]; then
+        echo "${ERR}fail${NORM}"
+        echo "exit status $RC, missing outputs:$MISSING, hi wrote '$HI_OUT'"
+        cat "$TMPDIR/log"
+    else
+        echo "${OK}ok${NORM}"
+    fi
+fi
+
 for TFILE in tests/*.b ; do
     TESTS_RAN=$((TESTS_RAN+1))
 
     TNAME=$(basename $TFILE .b)
     DFILE="${TFILE%.*}.dat"
+    FFILE="${TFILE%.*}.flags"
+    RFILE="${TFILE%.*}.report"
+
+    TFLAGS=""
+    [ -f $FFILE ] && TFLAGS=$(cat $FFILE)
 
     echo -en "$TNAME:\t"
 
-    # compile file
-    $BFC -o "$TMPDIR/$TNAME.o" $TFILE 2> "$TMPDIR/log"
-    RC=$?
-    LINES=$(wc -l <"$TMPDIR/log")
-    
-    if [ $RC -ne 0 ] || [ $LINES -gt 0 ]; then
-        echo "${ERR}fail${NORM}";
-        cat $TMPDIR/log
-        continue
+    PFLAGS=""
+    if [ -n "$BFCPROFILE" ]; then
+        PROFILE="$TMPDIR/$TNAME.prof"
+        PIN=""
+        [ -f $DFILE ] && PIN=$(grep -m 1 '^-' $DFILE)
+        printf "${PIN:1}" | $BFC $BFCFLAGS $TFLAGS -fprofile-generate="$PROFILE" -r $TFILE > /dev/null
+        PFLAGS="-fprofile-use=$PROFILE"
+    fi
+    [ -n "$BFCREPORT" ] && PFLAGS="$PFLAGS -p"
+
+    if [ -n "$BFCRUN" ]; then
+        RUN="$BFC $BFCFLAGS $TFLAGS $PFLAGS $BFCRUN $TFILE"
+    elif [ -n "$BFCBATCH" ] && [ -f "$BATCH/$TNAME.b" ]; then
+        # run the output of the batch, linking it unless it is executable.
+        RUN="$BATCH/$TNAME"
+        [ -x "$RUN" ] || ld -o "$RUN" "$RUN.o"
+    else
+        # compile file, or write it as c and build that.
+        if [ -n "$BFCC" ]; then
+            $BFC $BFCFLAGS $TFLAGS $PFLAGS -femit-c -o "$TMPDIR/$TNAME.c" $TFILE 2> "$TMPDIR/log" &&
+                $BFCC -o "$TMPDIR/$TNAME.o" "$TMPDIR/$TNAME.c" 2>> "$TMPDIR/log"
+        else
+            $BFC $BFCFLAGS $TFLAGS $PFLAGS -o "$TMPDIR/$TNAME.o" $TFILE 2> "$TMPDIR/log"
+        fi
+        RC=$?
+        LINES=$(wc -l <"$TMPDIR/log")
+
+        if [ $RC -ne 0 ] || [ $LINES -gt 0 ]; then
+            echo "${ERR}fail${NORM}";
+            cat $TMPDIR/log
+            continue
+        fi
+
+        # link file to executable, unless bfc already wrote one (-x).
+        RUN="$TMPDIR/$TNAME"
+        if [ -x "$TMPDIR/$TNAME.o" ]; then
+            mv "$TMPDIR/$TNAME.o" "$RUN"
+        else
+            ld -o "$RUN" "$TMPDIR/$TNAME.o"
+        fi
     fi
-
-    # link file to executable.
-    ld -o "$TMPDIR/$TNAME" "$TMPDIR/$TNAME.o"
     
     if [ -f $DFILE ]; then
         IN_STR=""
@@ -53,6 +146,7 @@ for TFILE in tests/*.b ; do
         IN="$TMPDIR/$TNAME"_in
         OUT="$TMPDIR/$TNAME"_out
         EXP="$TMPDIR/$TNAME"_exp
+        REP="$TMPDIR/$TNAME"_report
 
         touch $IN
         touch $EXP
@@ -77,7 +171,11 @@ for TFILE in tests/*.b ; do
             '%')
                 # Start evaluating the rule
                 SCENARIO_NO=$((SCENARIO_NO+1))
-                "$TMPDIR/$TNAME" < $IN > $OUT
+                if [ -n "$BFCREPORT" ]; then
+                    $RUN < $IN > $OUT 2> $REP
+                else
+                    $RUN < $IN > $OUT
+                fi
 
                 cmp -s $OUT $EXP || {
                     
@@ -92,6 +190,22 @@ for TFILE in tests/*.b ; do
                     hexdump -C $OUT
                     continue;
                 }
+
+                # only the iterations and the loop of each line are
+                # compared, as the rest depends on the optimizations.
+                if [ -n "$BFCREPORT" ] && [ $SCENARIO_NO -eq 1 ] && [ -f $RFILE ]; then
+                    awk 'NR > 1 { print $2, $4 }' $REP | sort > "$REP"_loops
+                    sort $RFILE | cmp -s - "$REP"_loops || {
+                        [ $ENCOUNTERED_FAIL -eq 1 ] || echo "${ERR}fail${NORM}";
+                        ENCOUNTERED_FAIL=1
+
+                        echo "${ERR}unexpected report${NORM} (scenario $SCENARIO_NO):";
+                        echo -e "${INFO}\texpected:${NORM}"
+                        sort $RFILE
+                        echo -e "${INFO}\tactual:${NORM}"
+                        cat "$REP"_loops
+                    }
+                fi
                 ;;
             esac
         done < $DFILE
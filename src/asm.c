@@ -1,10 +1,12 @@
 /**
  * Copyright (c) 2021 Olle Lögdahl
- * 
+ *
  * This software is released under the MIT License.
  * https://opensource.org/licenses/MIT
  */
 
+#define _DEFAULT_SOURCE
+
 #include "asm.h"
 
 #include <stdlib.h>
@@ -13,119 +15,1232 @@
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
 #include <asm/unistd_64.h>
 
-#define NL "\n"
+#include "err.h"
+
+#define TAPE_MSG "data pointer left the tape\n"
+#define NOMEM_MSG "could not map the tape\n"
+
+// sizes of the runtime i/o buffers in the generated program.
+#define OBUF_SIZE 65536
+#define IBUF_SIZE 65536
+
+// vector scans may read a full vector past the cell they stop at.
+#define SCAN_PAD 32
+
+// mapped tapes are handed out in pages, or in huge pages when asked for.
+#define TAPE_PAGE 4096
+#define TAPE_HUGE_PAGE (2 << 20)
+
+// a growing tape reserves this much address space on each side.
+#define TAPE_RESERVE (1ul << 30)
+
+// the kernel's sigaction takes the code returning from a handler.
+#define SA_RESTORER 0x04000000
+
+// the columns of the report of -p, the most loops it lists, and the stack
+// its signal handler runs on.
+#define REPORT_SHARE 8
+#define REPORT_COUNT 21
+#define REPORT_LOOPS 20
+#define REPORT_STACK 65536
+
+#define ROUND_UP(n, a) (((n) + (a) - 1) / (a) * (a))
+
+// the runtime works on whole 64 bit registers.
+static x86_op_t reg64(int reg) {
+    return x86_reg(reg, 8);
+}
+
+static void ins64(x86_as_t *as, x86_ins_e ins, x86_op_t src, x86_op_t dst) {
+    x86_ins2(as, ins, 8, src, dst);
+}
+
+static void mov_imm(x86_as_t *as, int64_t value, int reg) {
+    ins64(as, X86_MOV, x86_imm(value), reg64(reg));
+}
+
+static void mov_addr(x86_as_t *as, const char *sym, int reg) {
+    ins64(as, X86_MOV, x86_imm_sym(sym, 0), reg64(reg));
+}
+
+/**
+ * makes a system call, with its arguments already in place.
+ */
+static void sys(x86_as_t *as, int nr) {
+    mov_imm(as, nr, X86_RAX);
+    x86_ins0(as, X86_SYSCALL);
+}
+
+static void jump(x86_as_t *as, x86_ins_e ins, x86_op_t target) {
+    x86_ins1(as, ins, 0, target);
+}
+
+static void call(x86_as_t *as, const char *sym) {
+    jump(as, X86_CALL, x86_sym(sym, 0));
+}
+
+// a loop counter in a table of them, written with its offset even when zero.
+static x86_op_t counter(const char *table, int64_t offset) {
+    x86_op_t op = x86_sym(table, offset);
+    op.disp = true;
+    return op;
+}
+
+// the accumulator of a whole cell.
+static x86_op_t cell_acc(asm_info_t *info) {
+    return x86_reg(X86_RAX, info->cell_size);
+}
+
+static x86_op_t tape_cell(asm_info_t *info, int offset) {
+    return x86_mem(X86_RDI, offset * info->cell_size);
+}
+
+/**
+ * reduces an immediate to the width of a cell, as a signed value. 32 and
+ * 64 bit cells take every int as is.
+ */
+static int cell_imm(asm_info_t *info, int value) {
+    if(info->cell_size >= 4) return value;
+
+    int bits = 8 * info->cell_size;
+    int v = value & ((1 << bits) - 1);
+    return (v >= 1 << (bits - 1)) ? v - (1 << bits) : v;
+}
+
+// the registers cells are kept in. None of them are touched by syscalls or
+// the runtime.
+static const int cache_regs[CACHE_REGS] = {
+    X86_RBX, X86_RBP, X86_R8, X86_R9, X86_R10, X86_R15
+};
+
+static x86_op_t cache_reg(asm_info_t *info, int reg) {
+    return x86_reg(cache_regs[reg], info->cell_size);
+}
+
+/**
+ * returns the uses of the cell at offset in the current run, or NULL if
+ * it is not used more than once.
+ */
+static cell_use_t *cache_use(asm_info_t *info, int offset) {
+    cell_cache_t *c = &info->cells;
+    for(unsigned i = 0; i < c->hot_count; ++i) {
+        if(c->hot[i].offset == offset) return &c->hot[i];
+    }
+    return NULL;
+}
+
+/**
+ * returns the register a cell is kept in, or -1 if it stays on the tape.
+ * A cell that is used again later gets a free register, loaded from the
+ * tape unless the access overwrites it anyway.
+ */
+static int cache_get(asm_info_t *info, x86_as_t *as, cell_use_t *use, bool load) {
+    if(use == NULL) return -1;
+    if(use->reg >= 0 || use->uses < 2) return use->reg;
+
+    int reg = 0;
+    while(reg < CACHE_REGS && info->cells.regs[reg] != NULL) reg++;
+    if(reg == CACHE_REGS) return -1;
+
+    info->cells.regs[reg] = use;
+    info->cells.dirty[reg] = false;
+    use->reg = reg;
+    if(load) x86_ins2(as, X86_MOV, info->cell_size, tape_cell(info, use->offset), cache_reg(info, reg));
+    return reg;
+}
+
+/**
+ * frees a register, writing it back to the tape first if store is set and
+ * it changed.
+ */
+static void cache_free(asm_info_t *info, x86_as_t *as, int reg, bool store) {
+    cell_use_t *use = info->cells.regs[reg];
+    if(store && info->cells.dirty[reg]) {
+        x86_ins2(as, X86_MOV, info->cell_size, cache_reg(info, reg), tape_cell(info, use->offset));
+    }
+
+    use->reg = -1;
+    info->cells.regs[reg] = NULL;
+}
+
+/**
+ * counts a use of a cell. After its last one, its register is freed.
+ */
+static void cache_done(asm_info_t *info, x86_as_t *as, cell_use_t *use) {
+    if(use == NULL || --use->uses > 0) return;
+    if(use->reg >= 0) cache_free(info, as, use->reg, true);
+}
+
+/**
+ * writes every register back to the tape and ends the run of straight-line
+ * code.
+ */
+static void cache_flush(asm_info_t *info, x86_as_t *as) {
+    for(int r = 0; r < CACHE_REGS; ++r) {
+        if(info->cells.regs[r] != NULL) cache_free(info, as, r, true);
+    }
+    info->cells.hot_count = 0;
+}
 
-void asm_header(asm_info_t *info, FILE *out) {
+/**
+ * returns the operand of the cell at offset: its register, or the tape.
+ */
+static x86_op_t cell_operand(asm_info_t *info, int reg, int offset) {
+    return (reg >= 0) ? cache_reg(info, reg) : tape_cell(info, offset);
+}
+
+void asm_cache_plan(asm_info_t *info, x86_as_t *as, const cell_use_t *hot, unsigned count) {
+    assert(count <= CACHE_RUN);
+    cache_flush(info, as);
+
+    for(unsigned i = 0; i < count; ++i) {
+        info->cells.hot[i] = hot[i];
+        info->cells.hot[i].reg = -1;
+    }
+    info->cells.hot_count = count;
+}
+
+static void asm_string(x86_as_t *as, const char *label, const char *str) {
+    x86_label(as, label);
+    x86_bytes(as, (const unsigned char *) str, strlen(str));
+}
+
+/**
+ * The layout of a mapped tape. Cells in [lo, hi) are accessible, and the
+ * tape may grow to [min, max). The guard pages below min and above max
+ * are never accessible.
+ */
+typedef struct {
+    unsigned long align;
+    unsigned long size;
+    unsigned long reserve;
+    unsigned long guard;
+} tape_layout_t;
+
+static tape_layout_t tape_layout(asm_info_t *info) {
+    tape_layout_t l;
+    l.align = info->tape_hugepages ? TAPE_HUGE_PAGE : TAPE_PAGE;
+    l.size = ROUND_UP((unsigned long) info->stack_size * info->cell_size, l.align);
+    l.reserve = (info->tape == TAPE_GROW && l.size < TAPE_RESERVE) ? TAPE_RESERVE : l.size;
+    l.guard = ROUND_UP((unsigned long) info->tape_reach * info->cell_size + 2 * SCAN_PAD, TAPE_PAGE);
+    return l;
+}
+
+/**
+ * maps the tape, with everything but the initial cells inaccessible, and
+ * installs the handler for faults on the inaccessible part. It is called
+ * at startup, but written with the runtime, as the guard pages depend on
+ * the reach of all the code before it.
+ */
+static void asm_tape_map(asm_info_t *info, x86_as_t *as) {
+    tape_layout_t l = tape_layout(info);
+
+    x86_label(as, "_bf_tape_map");
+    mov_imm(as, 0, X86_RDI);
+    mov_imm(as, 2 * (l.guard + l.reserve) + l.align, X86_RSI);
+    mov_imm(as, PROT_NONE, X86_RDX);
+    mov_imm(as, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, X86_R10);
+    mov_imm(as, -1, X86_R8);
+    mov_imm(as, 0, X86_R9);
+    sys(as, __NR_mmap);
+    ins64(as, X86_CMP, x86_imm(-4095), reg64(X86_RAX));
+    jump(as, X86_JAE, x86_sym("_bf_nomem", 0));
+
+    // the middle of the tape is aligned, so huge pages line up with it.
+    mov_imm(as, l.guard + l.reserve + l.align - 1, X86_RCX);
+    ins64(as, X86_ADD, reg64(X86_RCX), reg64(X86_RAX));
+    ins64(as, X86_AND, x86_imm(-(long) l.align), reg64(X86_RAX));
+    ins64(as, X86_MOV, reg64(X86_RAX), x86_sym("_bf_tape_mid", 0));
+    mov_imm(as, l.reserve, X86_RDX);
+    ins64(as, X86_MOV, reg64(X86_RAX), reg64(X86_RCX));
+    ins64(as, X86_SUB, reg64(X86_RDX), reg64(X86_RCX));
+    ins64(as, X86_MOV, reg64(X86_RCX), x86_sym("_bf_tape_min", 0));
+    ins64(as, X86_ADD, reg64(X86_RAX), reg64(X86_RDX));
+    ins64(as, X86_MOV, reg64(X86_RDX), x86_sym("_bf_tape_max", 0));
+    mov_imm(as, l.size, X86_RDX);
+    ins64(as, X86_MOV, reg64(X86_RAX), reg64(X86_RDI));
+    ins64(as, X86_SUB, reg64(X86_RDX), reg64(X86_RDI));
+    ins64(as, X86_MOV, reg64(X86_RDI), x86_sym("_bf_tape_lo", 0));
+    ins64(as, X86_ADD, reg64(X86_RAX), reg64(X86_RDX));
+    ins64(as, X86_MOV, reg64(X86_RDX), x86_sym("_bf_tape_hi", 0));
+    mov_imm(as, 2 * l.size, X86_RSI);
+    mov_imm(as, PROT_READ | PROT_WRITE, X86_RDX);
+    sys(as, __NR_mprotect);
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JNZ, x86_sym("_bf_nomem", 0));
+
+    if(info->tape_hugepages) {
+        mov_imm(as, MADV_HUGEPAGE, X86_RDX);
+        sys(as, __NR_madvise);
+    }
+
+    // touch every page up front, instead of on first use.
+    if(info->tape_prefault) {
+        ins64(as, X86_MOV, x86_sym("_bf_tape_lo", 0), reg64(X86_RAX));
+        x86_local(as, 1);
+        x86_ins2(as, X86_MOV, 1, x86_imm(0), x86_at(X86_RAX));
+        ins64(as, X86_ADD, x86_imm(TAPE_PAGE), reg64(X86_RAX));
+        ins64(as, X86_CMP, x86_sym("_bf_tape_hi", 0), reg64(X86_RAX));
+        jump(as, X86_JB, x86_back(1));
+    }
+
+    mov_imm(as, SIGSEGV, X86_RDI);
+    mov_addr(as, "_bf_segv_action", X86_RSI);
+    mov_imm(as, 0, X86_RDX);
+    mov_imm(as, 8, X86_R10);
+    sys(as, __NR_rt_sigaction);
+    ins64(as, X86_MOV, x86_sym("_bf_tape_mid", 0), reg64(X86_RDI));
+    x86_ins0(as, X86_RET);
+}
+
+/**
+ * Writes the handler for faults on a mapped tape. A fault next to the
+ * accessible cells makes them accessible, doubling the tape (as far as it
+ * may grow) until it covers the faulting address, and the instruction is
+ * retried. A fault in the guard pages stops the program. Any other fault
+ * is not ours, and is retried with the default action, which kills the
+ * program as usual.
+ */
+static void asm_tape_runtime(asm_info_t *info, x86_as_t *as) {
+    tape_layout_t l = tape_layout(info);
+    asm_tape_map(info, as);
+
+    x86_label(as, "_bf_segv");
+    ins64(as, X86_MOV, x86_mem(X86_RSI, 16), reg64(X86_RAX));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_min", 0), reg64(X86_RCX));
+    ins64(as, X86_SUB, x86_imm(l.guard), reg64(X86_RCX));
+    ins64(as, X86_CMP, reg64(X86_RCX), reg64(X86_RAX));
+    jump(as, X86_JB, x86_forward(9));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_max", 0), reg64(X86_RCX));
+    ins64(as, X86_ADD, x86_imm(l.guard), reg64(X86_RCX));
+    ins64(as, X86_CMP, reg64(X86_RCX), reg64(X86_RAX));
+    jump(as, X86_JAE, x86_forward(9));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_hi", 0), reg64(X86_RCX));
+    ins64(as, X86_SUB, x86_sym("_bf_tape_lo", 0), reg64(X86_RCX));
+    ins64(as, X86_CMP, x86_sym("_bf_tape_lo", 0), reg64(X86_RAX));
+    jump(as, X86_JB, x86_forward(5));
+    ins64(as, X86_CMP, x86_sym("_bf_tape_hi", 0), reg64(X86_RAX));
+    jump(as, X86_JB, x86_forward(9));
+
+    // above the tape: mprotect(hi, new hi - hi).
+    ins64(as, X86_MOV, x86_sym("_bf_tape_hi", 0), reg64(X86_RDI));
+    x86_local(as, 1);
+    ins64(as, X86_ADD, reg64(X86_RCX), reg64(X86_RDI));
+    ins64(as, X86_CMP, reg64(X86_RDI), reg64(X86_RAX));
+    jump(as, X86_JAE, x86_back(1));
+    ins64(as, X86_CMP, x86_sym("_bf_tape_max", 0), reg64(X86_RDI));
+    jump(as, X86_JBE, x86_forward(2));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_max", 0), reg64(X86_RDI));
+    x86_local(as, 2);
+    ins64(as, X86_CMP, reg64(X86_RDI), reg64(X86_RAX));
+    jump(as, X86_JAE, x86_forward(8));
+    ins64(as, X86_MOV, reg64(X86_RDI), reg64(X86_RSI));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_hi", 0), reg64(X86_RDI));
+    ins64(as, X86_MOV, reg64(X86_RSI), x86_sym("_bf_tape_hi", 0));
+    ins64(as, X86_SUB, reg64(X86_RDI), reg64(X86_RSI));
+    jump(as, X86_JMP, x86_forward(6));
+
+    // below the tape: mprotect(new lo, lo - new lo).
+    x86_local(as, 5);
+    ins64(as, X86_MOV, x86_sym("_bf_tape_lo", 0), reg64(X86_RDI));
+    x86_local(as, 1);
+    ins64(as, X86_SUB, reg64(X86_RCX), reg64(X86_RDI));
+    ins64(as, X86_CMP, reg64(X86_RDI), reg64(X86_RAX));
+    jump(as, X86_JB, x86_back(1));
+    ins64(as, X86_CMP, x86_sym("_bf_tape_min", 0), reg64(X86_RDI));
+    jump(as, X86_JAE, x86_forward(2));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_min", 0), reg64(X86_RDI));
+    x86_local(as, 2);
+    ins64(as, X86_CMP, reg64(X86_RDI), reg64(X86_RAX));
+    jump(as, X86_JB, x86_forward(8));
+    ins64(as, X86_MOV, x86_sym("_bf_tape_lo", 0), reg64(X86_RSI));
+    ins64(as, X86_MOV, reg64(X86_RDI), x86_sym("_bf_tape_lo", 0));
+    ins64(as, X86_SUB, reg64(X86_RDI), reg64(X86_RSI));
+    x86_local(as, 6);
+    mov_imm(as, PROT_READ | PROT_WRITE, X86_RDX);
+    sys(as, __NR_mprotect);
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JNZ, x86_sym("_bf_nomem", 0));
+
+    if(info->tape_hugepages) {
+        mov_imm(as, MADV_HUGEPAGE, X86_RDX);
+        sys(as, __NR_madvise);
+    }
+
+    // the registers of the program are intact in the handler, so the
+    // output so far can still be flushed before stopping.
+    x86_ins0(as, X86_RET);
+    x86_local(as, 8);
+    call(as, "_bf_flush");
+    mov_addr(as, "_bf_tape_msg", X86_RSI);
+    mov_imm(as, strlen(TAPE_MSG), X86_RDX);
+    jump(as, X86_JMP, x86_sym("_bf_die", 0));
+    x86_local(as, 9);
+    mov_imm(as, SIGSEGV, X86_RDI);
+    mov_addr(as, "_bf_dfl_action", X86_RSI);
+    mov_imm(as, 0, X86_RDX);
+    mov_imm(as, 8, X86_R10);
+    sys(as, __NR_rt_sigaction);
+    x86_ins0(as, X86_RET);
+
+    x86_label(as, "_bf_nomem");
+    mov_addr(as, "_bf_nomem_msg", X86_RSI);
+    mov_imm(as, strlen(NOMEM_MSG), X86_RDX);
+    x86_label(as, "_bf_die");
+    mov_imm(as, STDERR_FILENO, X86_RDI);
+    sys(as, __NR_write);
+    mov_imm(as, 1, X86_RDI);
+    sys(as, __NR_exit);
+
+    x86_section(as, X86_DATA);
+    x86_label(as, "_bf_segv_action");
+    x86_op_t action[] = {
+        x86_imm_sym("_bf_segv", 0), x86_imm(SA_SIGINFO | SA_RESTORER), x86_imm_sym("_bf_sigreturn", 0), x86_imm(0)
+    };
+    x86_quad(as, action, 4);
+    x86_section(as, X86_RODATA);
+    asm_string(as, "_bf_tape_msg", TAPE_MSG);
+    asm_string(as, "_bf_nomem_msg", NOMEM_MSG);
+    x86_section(as, X86_TEXT);
+}
+
+/**
+ * returns whether the generated program counts how its loops run, for
+ * -fprofile-generate or for the report of -p.
+ */
+static bool counting(asm_info_t *info) {
+    return info->profile_generate != NULL || info->report;
+}
+
+/**
+ * Counts an entry into a loop. Each loop has a pair of counters, by label:
+ * its entries and its iterations.
+ */
+static void asm_count_entry(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    if(counting(info)) x86_ins1(as, X86_INC, 8, counter("_bf_prof_counts", 16 * label));
+}
+
+/**
+ * Counts an iteration of a loop, and the instructions it runs for the
+ * report.
+ */
+static void asm_count_iteration(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    if(counting(info)) x86_ins1(as, X86_INC, 8, counter("_bf_prof_counts", 16 * label + 8));
+    if(info->report) {
+        ins64(as, X86_ADD, x86_imm(info->loop_size[label - info->loop_base]), counter("_bf_report_insns", 8 * label));
+    }
+}
+
+/**
+ * writes the counters of -fprofile-generate to the profile file, replacing
+ * it. A profile that can not be written is silently skipped, the program
+ * still exits normally.
+ */
+static void asm_profile_dump(asm_info_t *info, x86_as_t *as) {
+    mov_addr(as, "_bf_prof_path", X86_RDI);
+    mov_imm(as, O_WRONLY | O_CREAT | O_TRUNC, X86_RSI);
+    mov_imm(as, 0644, X86_RDX);
+    sys(as, __NR_open);
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JS, x86_forward(1));
+    ins64(as, X86_MOV, reg64(X86_RAX), reg64(X86_RDI));
+    mov_addr(as, "_bf_prof", X86_RSI);
+    mov_imm(as, PROFILE_MAGIC_LEN + 8 + 16 * info->loops, X86_RDX);
+    sys(as, __NR_write);
+    sys(as, __NR_close);
+    x86_local(as, 1);
+}
+
+/**
+ * writes the counters, laid out as a profile file.
+ */
+static void asm_counters(asm_info_t *info, x86_as_t *as) {
+    x86_section(as, X86_DATA);
+    x86_label(as, "_bf_prof");
+    x86_bytes(as, (const unsigned char *) PROFILE_MAGIC, PROFILE_MAGIC_LEN);
+    x86_op_t loops = x86_imm(info->loops);
+    x86_quad(as, &loops, 1);
+    x86_label(as, "_bf_prof_counts");
+    x86_skip(as, 16 * info->loops);
+
+    if(info->profile_generate != NULL) {
+        x86_section(as, X86_RODATA);
+        x86_label(as, "_bf_prof_path");
+        x86_bytes(as, (const unsigned char *) info->profile_generate, strlen(info->profile_generate) + 1);
+    }
+    x86_section(as, X86_TEXT);
+}
+
+/**
+ * installs the handler that writes the report on SIGUSR1. It runs on a
+ * stack of its own, as the program's stack may sit right above the tape.
+ */
+static void asm_report_setup(x86_as_t *as) {
+    x86_ins1(as, X86_PUSH, 8, reg64(X86_RDI));
+    mov_addr(as, "_bf_report_altstack", X86_RDI);
+    mov_imm(as, 0, X86_RSI);
+    sys(as, __NR_sigaltstack);
+    mov_imm(as, SIGUSR1, X86_RDI);
+    mov_addr(as, "_bf_report_action", X86_RSI);
+    mov_imm(as, 0, X86_RDX);
+    mov_imm(as, 8, X86_R10);
+    sys(as, __NR_rt_sigaction);
+    x86_ins1(as, X86_POP, 8, reg64(X86_RDI));
+}
+
+/**
+ * writes where a loop is in the source to buf, as file:line:column of its
+ * opening bracket and line:column of its closing one, and a newline.
+ * Returns the length, which is cut short to fit.
+ */
+static int loop_source(asm_info_t *info, unsigned label, char *buf, size_t size) {
+    srcrange_t src = info->loop_src[label - info->loop_base];
+    int len = snprintf(buf, size - 1, "%s:%u:%u-%u:%u", info->source_name,
+        src.begin.line, src.begin.column, src.end.line, src.end.column);
+    if(len < 0) len = 0;
+    if((size_t) len > size - 2) len = size - 2;
+
+    buf[len++] = '\n';
+    return len;
+}
+
+/**
+ * Writes the report of -p to stderr: the loops that ran the most
+ * instructions of their own, the busiest first, as a share of all
+ * instructions, with their iterations and where they are in the source.
+ * The seen flags mark the loops already reported.
+ *
+ * _bf_report_num writes %rax in decimal, ending right before %rdi, and
+ * leaves %rdi at its first digit.
+ */
+static void asm_report_runtime(asm_info_t *info, x86_as_t *as) {
+    char head[128];
+    int head_len = snprintf(head, sizeof head, "%*s%*s%*s  %s\n",
+        REPORT_SHARE, "share", REPORT_COUNT, "iterations", REPORT_COUNT, "instructions", "loop");
+    unsigned line = REPORT_SHARE + 2 * REPORT_COUNT + 2;
+
+    x86_label(as, "_bf_report");
+    mov_addr(as, "_bf_report_insns", X86_RBX);
+    mov_addr(as, "_bf_report_seen", X86_R15);
+    mov_imm(as, info->top_size + 1, X86_R8);
+    mov_imm(as, 0, X86_RCX);
+    x86_local(as, 1);
+    ins64(as, X86_CMP, x86_imm(info->loops), reg64(X86_RCX));
+    jump(as, X86_JAE, x86_forward(2));
+    ins64(as, X86_ADD, x86_at_index(X86_RBX, X86_RCX, 8), reg64(X86_R8));
+    x86_ins2(as, X86_MOV, 1, x86_imm(0), x86_at_index(X86_R15, X86_RCX, 1));
+    x86_ins1(as, X86_INC, 8, reg64(X86_RCX));
+    jump(as, X86_JMP, x86_back(1));
+    x86_local(as, 2);
+    mov_imm(as, STDERR_FILENO, X86_RDI);
+    mov_addr(as, "_bf_report_head", X86_RSI);
+    mov_imm(as, head_len, X86_RDX);
+    sys(as, __NR_write);
+    mov_imm(as, REPORT_LOOPS, X86_R9);
+
+    // find the busiest loop that is not reported yet.
+    x86_local(as, 3);
+    mov_imm(as, 0, X86_RCX);
+    mov_imm(as, 0, X86_R11);
+    x86_local(as, 4);
+    ins64(as, X86_CMP, x86_imm(info->loops), reg64(X86_RCX));
+    jump(as, X86_JAE, x86_forward(6));
+    x86_ins2(as, X86_CMP, 1, x86_imm(0), x86_at_index(X86_R15, X86_RCX, 1));
+    jump(as, X86_JNE, x86_forward(5));
+    ins64(as, X86_MOV, x86_at_index(X86_RBX, X86_RCX, 8), reg64(X86_RAX));
+    ins64(as, X86_CMP, reg64(X86_R11), reg64(X86_RAX));
+    jump(as, X86_JBE, x86_forward(5));
+    ins64(as, X86_MOV, reg64(X86_RAX), reg64(X86_R11));
+    ins64(as, X86_MOV, reg64(X86_RCX), reg64(X86_R10));
+    x86_local(as, 5);
+    x86_ins1(as, X86_INC, 8, reg64(X86_RCX));
+    jump(as, X86_JMP, x86_back(4));
+    x86_local(as, 6);
+    ins64(as, X86_TEST, reg64(X86_R11), reg64(X86_R11));
+    jump(as, X86_JZ, x86_forward(9));
+    x86_ins2(as, X86_MOV, 1, x86_imm(1), x86_at_index(X86_R15, X86_R10, 1));
+
+    // the share in hundredths of a percent, its iterations and
+    // instructions, right aligned in the columns of the head.
+    mov_addr(as, "_bf_report_line", X86_RDI);
+    x86_ins2(as, X86_MOV, 1, x86_imm(32), x86_reg(X86_RAX, 1));
+    mov_imm(as, line, X86_RCX);
+    x86_ins0(as, X86_REP_STOSB);
+    x86_ins2(as, X86_MOV, 1, x86_imm(37), x86_sym("_bf_report_line", REPORT_SHARE - 1));
+    ins64(as, X86_MOV, reg64(X86_R11), reg64(X86_RAX));
+    mov_imm(as, 10000, X86_RCX);
+    x86_ins1(as, X86_MUL, 8, reg64(X86_RCX));
+    x86_ins1(as, X86_DIV, 8, reg64(X86_R8));
+    ins64(as, X86_MOV, x86_imm_sym("_bf_report_line", REPORT_SHARE - 1), reg64(X86_RDI));
+    mov_imm(as, 10, X86_RCX);
+    mov_imm(as, 0, X86_RDX);
+    x86_ins1(as, X86_DIV, 8, reg64(X86_RCX));
+    x86_ins2(as, X86_ADD, 1, x86_imm(48), x86_reg(X86_RDX, 1));
+    x86_ins2(as, X86_MOV, 1, x86_reg(X86_RDX, 1), x86_mem(X86_RDI, -1));
+    mov_imm(as, 0, X86_RDX);
+    x86_ins1(as, X86_DIV, 8, reg64(X86_RCX));
+    x86_ins2(as, X86_ADD, 1, x86_imm(48), x86_reg(X86_RDX, 1));
+    x86_ins2(as, X86_MOV, 1, x86_reg(X86_RDX, 1), x86_mem(X86_RDI, -2));
+    x86_ins2(as, X86_MOV, 1, x86_imm(46), x86_mem(X86_RDI, -3));
+    ins64(as, X86_SUB, x86_imm(3), reg64(X86_RDI));
+    call(as, "_bf_report_num");
+    ins64(as, X86_MOV, reg64(X86_R10), reg64(X86_RAX));
+    ins64(as, X86_SHL, x86_imm(4), reg64(X86_RAX));
+    ins64(as, X86_MOV, x86_sym_base("_bf_prof_counts", 8, X86_RAX), reg64(X86_RAX));
+    ins64(as, X86_MOV, x86_imm_sym("_bf_report_line", REPORT_SHARE + REPORT_COUNT), reg64(X86_RDI));
+    call(as, "_bf_report_num");
+    ins64(as, X86_MOV, reg64(X86_R11), reg64(X86_RAX));
+    ins64(as, X86_MOV, x86_imm_sym("_bf_report_line", REPORT_SHARE + 2 * REPORT_COUNT), reg64(X86_RDI));
+    call(as, "_bf_report_num");
+
+    // the line, followed by where the loop is.
+    mov_imm(as, STDERR_FILENO, X86_RDI);
+    mov_addr(as, "_bf_report_line", X86_RSI);
+    mov_imm(as, line, X86_RDX);
+    sys(as, __NR_write);
+    ins64(as, X86_MOV, reg64(X86_R10), reg64(X86_RAX));
+    ins64(as, X86_SHL, x86_imm(4), reg64(X86_RAX));
+    ins64(as, X86_MOV, x86_sym_base("_bf_report_src", 8, X86_RAX), reg64(X86_RDX));
+    ins64(as, X86_MOV, x86_sym_base("_bf_report_src", 0, X86_RAX), reg64(X86_RSI));
+    sys(as, __NR_write);
+    x86_ins1(as, X86_DEC, 8, reg64(X86_R9));
+    jump(as, X86_JNZ, x86_back(3));
+    x86_local(as, 9);
+    x86_ins0(as, X86_RET);
+
+    x86_label(as, "_bf_report_num");
+    mov_imm(as, 10, X86_RCX);
+    x86_local(as, 1);
+    mov_imm(as, 0, X86_RDX);
+    x86_ins1(as, X86_DIV, 8, reg64(X86_RCX));
+    x86_ins2(as, X86_ADD, 1, x86_imm(48), x86_reg(X86_RDX, 1));
+    x86_ins1(as, X86_DEC, 8, reg64(X86_RDI));
+    x86_ins2(as, X86_MOV, 1, x86_reg(X86_RDX, 1), x86_at(X86_RDI));
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JNZ, x86_back(1));
+    x86_ins0(as, X86_RET);
+    x86_label(as, "_bf_report_signal");
+    call(as, "_bf_report");
+    x86_ins0(as, X86_RET);
+
+    x86_section(as, X86_BSS);
+    x86_label(as, "_bf_report_stack");
+    x86_skip(as, REPORT_STACK);
+    x86_label(as, "_bf_report_insns");
+    x86_skip(as, 8 * info->loops);
+    x86_label(as, "_bf_report_seen");
+    x86_skip(as, info->loops);
+    x86_label(as, "_bf_report_line");
+    x86_skip(as, line);
+    x86_section(as, X86_DATA);
+    x86_label(as, "_bf_report_altstack");
+    x86_op_t stack[] = { x86_imm_sym("_bf_report_stack", 0), x86_imm(0), x86_imm(REPORT_STACK) };
+    x86_quad(as, stack, 3);
+    x86_label(as, "_bf_report_action");
+    x86_op_t action[] = {
+        x86_imm_sym("_bf_report_signal", 0), x86_imm(SA_RESTORER | SA_ONSTACK | SA_RESTART),
+        x86_imm_sym("_bf_sigreturn", 0), x86_imm(0)
+    };
+    x86_quad(as, action, 4);
+    x86_label(as, "_bf_report_ignore");
+    x86_op_t ignore[] = { x86_imm((int) (intptr_t) SIG_IGN), x86_imm(0), x86_imm(0), x86_imm(0) };
+    x86_quad(as, ignore, 4);
+    x86_section(as, X86_RODATA);
+
+    asm_string(as, "_bf_report_head", head);
+
+    // where each loop is, by label, as a pointer and a length.
+    char name[32];
+    for(unsigned i = 0; i < info->loops; ++i) {
+        char src[256];
+        sprintf(name, "_bf_report_src_%u", i);
+        x86_label(as, name);
+        x86_bytes(as, (const unsigned char *) src, loop_source(info, i, src, sizeof src));
+    }
+    x86_label(as, "_bf_report_src");
+    for(unsigned i = 0; i < info->loops; ++i) {
+        char src[256];
+        sprintf(name, "_bf_report_src_%u", i);
+        x86_op_t entry[] = { x86_imm_sym(name, 0), x86_imm(loop_source(info, i, src, sizeof src)) };
+        x86_quad(as, entry, 2);
+    }
+    x86_section(as, X86_TEXT);
+}
+
+void asm_header(asm_info_t *info, x86_as_t *as) {
     // Writes the header
     // %rdi stores the data pointer. %rsp stores the stack pointer, and
     // %rbp stores the base pointer.
-    fprintf(out,
-    ".section .bss" NL
-    ".skip %d" NL
-    "tape_mid:" NL
-    ".skip %d" NL
-    "tape_start:" NL
-    ".section .text" NL
-    ".global _start" NL
-    "_start:" NL
-    "lea tape_start, %%rsp" NL
-    "lea tape_mid, %%rdi" NL
-    "_program:" NL
-    , info->stack_size, info->stack_size);
-}
-
-void asm_footer(asm_info_t *info, FILE *out) {
-    fprintf(out,
-    "_end:" NL
-    "movq $0, %%rdi" NL
-    "movq $%d, %%rax" NL
-    "syscall" NL
-    , __NR_exit);
-}
-
-void asm_move(asm_info_t *info, FILE *out, const int offset) {
-    char *op = (offset > 0) ? "addq" : "subq";
-    fprintf(out, "%s $%d, %%rdi\n", op, abs(offset));
-}
-
-void asm_diff(asm_info_t *info, FILE *out, const int diff) {
-    assert(diff != 0);
-
-    char *op = (diff > 0) ? "addb" : "subb";
-    fprintf(out, "%s $%d, (%%rdi)\n", op, abs(diff));
-}
-
-void asm_set(asm_info_t *info, FILE *out, const int value) {
-    fprintf(out, "movb $%d, (%%rdi)\n", value);
-}
-
-void asm_copy(asm_info_t *info, FILE *out, const int offset) {
-    fprintf(out,
-    "movb (%%rdi), %%ah" NL
-    "addb %%ah, %d(%%rdi)" NL
-    , offset);
-}
-
-void asm_mult(asm_info_t *info, FILE *out, const int factor, const int offset) {
-    fprintf(out,
-    "movb $%d, %%al" NL
-    "imulb (%%rdi)" NL
-    "addb %%al, %d(%%rdi)" NL
-    , factor, offset);
-}
-
-void asm_branch_begin(asm_info_t *info, FILE *out, const char *name) {
-    fprintf(out,
-    "movb (%%rdi), %%al" NL
-    "cmpb $0, %%al" NL
-    "je b_%s_end" NL
-    "b_%s_start:" NL
-    , name, name);
-}
-
-void asm_branch_end(asm_info_t *info, FILE *out, const char *name) {
-    fprintf(out,
-    "movb (%%rdi), %%al" NL
-    "cmpb $0, %%al" NL
-    "jne b_%s_start" NL
-    "b_%s_end:" NL
-    , name, name);
-}
-
-void asm_write(asm_info_t *info, FILE *out) {
-    // calls write(STDOUT, %rdi, 1);
-    fprintf(out,
-    "pushq %%rdi" NL
-    "movq %%rdi, %%rsi" NL
-    "movq $1, %%rdx" NL
-    "movq $%d, %%rdi" NL
-    "movq $%d, %%rax" NL 
-    "syscall" NL
-    "popq %%rdi" NL
-    , STDOUT_FILENO, __NR_write);
-}
-
-void asm_read(asm_info_t *info, FILE *out) {
-    fprintf(out,
-    "pushq %%rdi" NL
-    "movq %%rdi, %%rsi" NL
-    "movq $1, %%rdx" NL
-    "movq $%d, %%rdi" NL
-    "movq $%d, %%rax" NL
-    "syscall" NL
-    "popq %%rdi" NL
-    , STDIN_FILENO, __NR_read);
-}
-
-void asm_comment(asm_info_t *info, FILE *out, char *fmt, ...) {
+    // %r12 is the write cursor in the output buffer, %r13 and %r14 are
+    // the read cursor and end of the buffered input.
+    x86_section(as, X86_BSS);
+    x86_label(as, "_bf_obuf");
+    x86_skip(as, OBUF_SIZE);
+    x86_label(as, "_bf_obuf_end");
+    x86_label(as, "_bf_ibuf");
+    x86_skip(as, IBUF_SIZE);
+
+    if(info->tape == TAPE_STATIC) {
+        x86_skip(as, info->stack_size * info->cell_size);
+        x86_label(as, "tape_mid");
+        x86_skip(as, info->stack_size * info->cell_size);
+        x86_label(as, "tape_start");
+        x86_skip(as, SCAN_PAD);
+        x86_section(as, X86_TEXT);
+        x86_global(as, "_start");
+        x86_label(as, "_start");
+        x86_ins2(as, X86_LEA, 0, x86_sym("tape_start", 0), reg64(X86_RSP));
+        x86_ins2(as, X86_LEA, 0, x86_sym("tape_mid", 0), reg64(X86_RDI));
+    } else {
+        // a mapped tape runs on the stack the program was started with.
+        x86_label(as, "_bf_tape_mid");
+        x86_skip(as, 8);
+        x86_label(as, "_bf_tape_lo");
+        x86_skip(as, 8);
+        x86_label(as, "_bf_tape_hi");
+        x86_skip(as, 8);
+        x86_label(as, "_bf_tape_min");
+        x86_skip(as, 8);
+        x86_label(as, "_bf_tape_max");
+        x86_skip(as, 8);
+        x86_label(as, "_bf_dfl_action");
+        x86_skip(as, 32);
+        x86_section(as, X86_TEXT);
+        x86_global(as, "_start");
+        x86_label(as, "_start");
+        call(as, "_bf_tape_map");
+    }
+
+    if(info->report) asm_report_setup(as);
+
+    mov_addr(as, "_bf_obuf", X86_R12);
+    mov_addr(as, "_bf_ibuf", X86_R13);
+    ins64(as, X86_MOV, reg64(X86_R13), reg64(X86_R14));
+    x86_label(as, "_program");
+}
+
+void asm_prefix(asm_info_t *info, x86_as_t *as, const prefix_t *prefix) {
+    int len = (prefix->high - prefix->low) * info->cell_size;
+
+    if(len > 0) {
+        x86_section(as, X86_DATA);
+        x86_label(as, "_bf_prefix_tape");
+        x86_bytes(as, prefix->cells, len);
+
+        // copy the image of the evaluated cells into the tape.
+        x86_section(as, X86_TEXT);
+        mov_addr(as, "_bf_prefix_tape", X86_RSI);
+        ins64(as, X86_LEA, tape_cell(info, prefix->low), reg64(X86_RDI));
+        mov_imm(as, len, X86_RCX);
+        x86_ins0(as, X86_REP_MOVSB);
+        if(info->tape == TAPE_STATIC) x86_ins2(as, X86_LEA, 0, x86_sym("tape_mid", 0), reg64(X86_RDI));
+        else ins64(as, X86_MOV, x86_sym("_bf_tape_mid", 0), reg64(X86_RDI));
+    }
+
+    if(prefix->output_len > 0) {
+        x86_section(as, X86_RODATA);
+        x86_label(as, "_bf_prefix_out");
+        x86_bytes(as, prefix->output, prefix->output_len);
+
+        x86_section(as, X86_TEXT);
+        mov_addr(as, "_bf_prefix_out", X86_RSI);
+        mov_imm(as, prefix->output_len, X86_RDX);
+        call(as, "_bf_write");
+    }
+
+    if(prefix->ptr != 0) asm_move(info, as, prefix->ptr);
+    jump(as, X86_JMP, x86_sym("_resume", 0));
+}
+
+void asm_resume(asm_info_t *info, x86_as_t *as) {
+    cache_flush(info, as);
+    x86_label(as, "_resume");
+}
+
+/**
+ * Writes the runtime subroutines used by the generated program.
+ *
+ * _bf_write writes %rdx bytes at %rsi to stdout. _bf_flush writes the
+ * contents of the output buffer and resets the write cursor. _bf_getc reads
+ * a byte from the input buffer into the current cell, refilling the buffer
+ * when it is exhausted. Output is always flushed before blocking on a read,
+ * so prompts are visible.
+ */
+static void asm_runtime(asm_info_t *info, x86_as_t *as) {
+    x86_label(as, "_bf_write");
+    x86_ins1(as, X86_PUSH, 8, reg64(X86_RDI));
+    ins64(as, X86_TEST, reg64(X86_RDX), reg64(X86_RDX));
+    jump(as, X86_JZ, x86_forward(2));
+    x86_local(as, 1);
+    mov_imm(as, STDOUT_FILENO, X86_RDI);
+    sys(as, __NR_write);
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JLE, x86_forward(2));
+    ins64(as, X86_ADD, reg64(X86_RAX), reg64(X86_RSI));
+    ins64(as, X86_SUB, reg64(X86_RAX), reg64(X86_RDX));
+    jump(as, X86_JNZ, x86_back(1));
+    x86_local(as, 2);
+    x86_ins1(as, X86_POP, 8, reg64(X86_RDI));
+    x86_ins0(as, X86_RET);
+
+    x86_label(as, "_bf_flush");
+    mov_addr(as, "_bf_obuf", X86_RSI);
+    ins64(as, X86_MOV, reg64(X86_R12), reg64(X86_RDX));
+    ins64(as, X86_SUB, reg64(X86_RSI), reg64(X86_RDX));
+    call(as, "_bf_write");
+    mov_addr(as, "_bf_obuf", X86_R12);
+    x86_ins0(as, X86_RET);
+
+    x86_label(as, "_bf_getc");
+    ins64(as, X86_CMP, reg64(X86_R14), reg64(X86_R13));
+    jump(as, X86_JB, x86_forward(1));
+    call(as, "_bf_flush");
+    x86_ins1(as, X86_PUSH, 8, reg64(X86_RDI));
+    mov_imm(as, STDIN_FILENO, X86_RDI);
+    mov_addr(as, "_bf_ibuf", X86_RSI);
+    mov_imm(as, IBUF_SIZE, X86_RDX);
+    sys(as, __NR_read);
+    x86_ins1(as, X86_POP, 8, reg64(X86_RDI));
+    ins64(as, X86_TEST, reg64(X86_RAX), reg64(X86_RAX));
+    jump(as, X86_JLE, x86_forward(2));
+    mov_addr(as, "_bf_ibuf", X86_R13);
+    ins64(as, X86_LEA, x86_at_index(X86_R13, X86_RAX, 1), reg64(X86_R14));
+    x86_local(as, 1);
+    if(info->cell_size == 1) x86_ins2(as, X86_MOV, 1, x86_at(X86_R13), x86_reg(X86_RAX, 1));
+    else x86_ins2(as, X86_MOVZBL, 0, x86_at(X86_R13), x86_reg(X86_RAX, 4));
+    x86_ins1(as, X86_INC, 8, reg64(X86_R13));
+    x86_ins2(as, X86_MOV, info->cell_size, cell_acc(info), x86_at(X86_RDI));
+    x86_ins0(as, X86_RET);
+    x86_local(as, 2);
+
+    // on end of input (or a failed read) the cell is handled as requested.
+    switch (info->eof_handling) {
+    case ZERO:
+        x86_ins2(as, X86_MOV, info->cell_size, x86_imm(0), x86_at(X86_RDI));
+        break;
+    case NEGATIVE:
+        x86_ins2(as, X86_MOV, info->cell_size, x86_imm(-1), x86_at(X86_RDI));
+        break;
+    case UNCHANGED:
+        break;
+    }
+
+    x86_ins0(as, X86_RET);
+
+    // the restorer of the signal handlers.
+    if(info->tape != TAPE_STATIC || info->report) {
+        x86_label(as, "_bf_sigreturn");
+        sys(as, __NR_rt_sigreturn);
+    }
+
+    if(info->tape != TAPE_STATIC) asm_tape_runtime(info, as);
+    if(info->report) asm_report_runtime(info, as);
+}
+
+void asm_footer(asm_info_t *info, x86_as_t *as) {
+    cache_flush(info, as);
+
+    x86_label(as, "_end");
+    call(as, "_bf_flush");
+    if(info->profile_generate != NULL) asm_profile_dump(info, as);
+    if(info->report) {
+        // the last report is not interrupted by another one.
+        mov_imm(as, SIGUSR1, X86_RDI);
+        mov_addr(as, "_bf_report_ignore", X86_RSI);
+        mov_imm(as, 0, X86_RDX);
+        mov_imm(as, 8, X86_R10);
+        sys(as, __NR_rt_sigaction);
+        call(as, "_bf_report");
+    }
+
+    mov_imm(as, 0, X86_RDI);
+    sys(as, __NR_exit);
+
+    asm_runtime(info, as);
+    if(counting(info)) asm_counters(info, as);
+}
+
+void asm_move(asm_info_t *info, x86_as_t *as, const int offset) {
+    cache_flush(info, as);
+    x86_ins_e op = (offset > 0) ? X86_ADD : X86_SUB;
+    ins64(as, op, x86_imm(abs(offset) * info->cell_size), reg64(X86_RDI));
+}
+
+void asm_diff(asm_info_t *info, x86_as_t *as, const int offset, const int diff) {
+    // a whole turn around the cell changes nothing.
+    int d = cell_imm(info, diff);
+    cell_use_t *use = cache_use(info, offset);
+    if(d != 0) {
+        x86_ins_e op = (d > 0) ? X86_ADD : X86_SUB;
+        int reg = cache_get(info, as, use, true);
+        x86_ins2(as, op, info->cell_size, x86_imm(abs(d)), cell_operand(info, reg, offset));
+        if(reg >= 0) info->cells.dirty[reg] = true;
+    }
+
+    cache_done(info, as, use);
+}
+
+void asm_set(asm_info_t *info, x86_as_t *as, const int offset, const int value) {
+    // a register that is not read again is dropped, the value goes
+    // straight to the tape.
+    cell_use_t *use = cache_use(info, offset);
+    if(use != NULL && use->reg >= 0 && use->uses == 1) cache_free(info, as, use->reg, false);
+
+    int reg = cache_get(info, as, use, false);
+    x86_ins2(as, X86_MOV, info->cell_size, x86_imm(cell_imm(info, value)), cell_operand(info, reg, offset));
+    if(reg >= 0) info->cells.dirty[reg] = true;
+    cache_done(info, as, use);
+}
+
+// the bytes of the smallest vector, and the fewest cells one has to cover
+// to be worth it.
+#define VECTOR_BYTES 16
+#define VECTOR_MIN_CELLS 8
+
+unsigned asm_vector_cells(asm_info_t *info) {
+    unsigned cells = VECTOR_BYTES / info->cell_size;
+    return (info->simd == SCALAR || cells < VECTOR_MIN_CELLS) ? 0 : cells;
+}
+
+/**
+ * writes a constant vector to .rodata, and its name to buf. The constants
+ * are numbered within the part, so parts compiled apart never share a name.
+ */
+static void vector_const(asm_info_t *info, x86_as_t *as, const unsigned char *bytes, unsigned len, char *buf) {
+    sprintf(buf, "_bf_vec_%u_%u", info->part, info->vectors++);
+    x86_section(as, X86_RODATA);
+    x86_label(as, buf);
+    x86_bytes(as, bytes, len);
+    x86_section(as, X86_TEXT);
+}
+
+/**
+ * adds to or sets the cells of one vector of width bytes at offset. Set
+ * cells are masked out before the constant is added, and a vector of only
+ * set cells is stored without loading it.
+ */
+static void vector_chunk(asm_info_t *info, x86_as_t *as, const int offset, unsigned width, const int *values, const bool *sets) {
+    unsigned size = info->cell_size;
+    unsigned char value[2 * VECTOR_BYTES], mask[2 * VECTOR_BYTES];
+    bool all_set = true, any_set = false, nonzero = false;
+
+    for(unsigned i = 0; i < width / size; ++i) {
+        uint64_t v = (uint64_t) (int64_t) values[i];
+        for(unsigned b = 0; b < size; ++b) {
+            value[i * size + b] = v >> (8 * b);
+            mask[i * size + b] = sets[i] ? 0 : 0xff;
+            if(value[i * size + b] != 0) nonzero = true;
+        }
+        all_set = all_set && sets[i];
+        any_set = any_set || sets[i];
+    }
+
+    bool avx = (width == 2 * VECTOR_BYTES);
+    x86_ins_e mov = avx ? X86_VMOVDQU : X86_MOVDQU;
+    x86_op_t reg = x86_reg(0, width);
+    x86_op_t tmp = x86_reg(1, width);
+    x86_ins_e add = (size == 1) ? (avx ? X86_VPADDB : X86_PADDB) : (avx ? X86_VPADDW : X86_PADDW);
+    char name[64];
+
+    if(all_set && !nonzero) {
+        if(avx) x86_ins3(as, X86_VPXOR, 0, reg, reg, reg);
+        else x86_ins2(as, X86_PXOR, 0, reg, reg);
+    } else if(all_set) {
+        vector_const(info, as, value, width, name);
+        x86_ins2(as, mov, 0, x86_sym(name, 0), reg);
+    } else {
+        x86_ins2(as, mov, 0, tape_cell(info, offset), reg);
+        if(any_set) {
+            vector_const(info, as, mask, width, name);
+            if(avx) {
+                x86_ins3(as, X86_VPAND, 0, x86_sym(name, 0), reg, reg);
+            } else {
+                x86_ins2(as, X86_MOVDQU, 0, x86_sym(name, 0), tmp);
+                x86_ins2(as, X86_PAND, 0, tmp, reg);
+            }
+        }
+        if(nonzero) {
+            vector_const(info, as, value, width, name);
+            if(avx) {
+                x86_ins3(as, add, 0, x86_sym(name, 0), reg, reg);
+            } else {
+                x86_ins2(as, X86_MOVDQU, 0, x86_sym(name, 0), tmp);
+                x86_ins2(as, add, 0, tmp, reg);
+            }
+        }
+    }
+    x86_ins2(as, mov, 0, reg, tape_cell(info, offset));
+}
+
+void asm_vector(asm_info_t *info, x86_as_t *as, const int offset, const unsigned count, const int *values, const bool *sets) {
+    unsigned lanes = asm_vector_cells(info);
+    assert(lanes > 0 && count % lanes == 0);
+
+    // the cells are updated on the tape. A register holding one is written
+    // back first, unless the cell is set anyway, and counts this use.
+    for(unsigned i = 0; i < count; ++i) {
+        cell_use_t *use = cache_use(info, offset + i);
+        if(use == NULL) continue;
+        if(use->reg >= 0) cache_free(info, as, use->reg, !sets[i]);
+        use->uses--;
+    }
+
+    // avx2 takes two vectors at a time, and the upper halves are cleared
+    // before any sse instruction follows.
+    unsigned i = 0;
+    if(info->simd == AVX2) {
+        for(; i + 2 * lanes <= count; i += 2 * lanes) {
+            vector_chunk(info, as, offset + i, 2 * VECTOR_BYTES, values + i, sets + i);
+        }
+        if(i > 0) x86_ins0(as, X86_VZEROUPPER);
+    }
+    for(; i < count; i += lanes) vector_chunk(info, as, offset + i, VECTOR_BYTES, values + i, sets + i);
+}
+
+void asm_copy(asm_info_t *info, x86_as_t *as, const int src, const int dst) {
+    int size = info->cell_size;
+    cell_use_t *src_use = cache_use(info, src);
+    cell_use_t *dst_use = cache_use(info, dst);
+    int src_reg = cache_get(info, as, src_use, true);
+    int dst_reg = cache_get(info, as, dst_use, true);
+
+    if(src_reg < 0 && dst_reg < 0) {
+        x86_op_t reg = (size == 1) ? x86_high(X86_RAX) : cell_acc(info);
+        x86_ins2(as, X86_MOV, size, tape_cell(info, src), reg);
+        x86_ins2(as, X86_ADD, size, reg, tape_cell(info, dst));
+    } else if(src_reg >= 0) {
+        x86_ins2(as, X86_ADD, size, cache_reg(info, src_reg), cell_operand(info, dst_reg, dst));
+    } else {
+        // %ah can not be used along with the new byte registers.
+        x86_ins2(as, X86_MOV, size, tape_cell(info, src), cell_acc(info));
+        x86_ins2(as, X86_ADD, size, cell_acc(info), cache_reg(info, dst_reg));
+    }
+
+    if(dst_reg >= 0) info->cells.dirty[dst_reg] = true;
+    cache_done(info, as, src_use);
+    cache_done(info, as, dst_use);
+}
+
+void asm_mult(asm_info_t *info, x86_as_t *as, const int factor, const int src, const int dst) {
+    int size = info->cell_size;
+    cell_use_t *src_use = cache_use(info, src);
+    cell_use_t *dst_use = cache_use(info, dst);
+    int src_reg = cache_get(info, as, src_use, true);
+    int dst_reg = cache_get(info, as, dst_use, true);
+
+    x86_op_t from = cell_operand(info, src_reg, src);
+    x86_op_t to = cell_operand(info, dst_reg, dst);
+
+    // byte multiplies only exist on the accumulator.
+    if(size == 1) {
+        x86_ins2(as, X86_MOV, 1, x86_imm(cell_imm(info, factor)), cell_acc(info));
+        x86_ins1(as, X86_IMUL, 1, from);
+    } else {
+        x86_ins3(as, X86_IMUL, size, x86_imm(cell_imm(info, factor)), from, cell_acc(info));
+    }
+    x86_ins2(as, X86_ADD, size, cell_acc(info), to);
+
+    if(dst_reg >= 0) info->cells.dirty[dst_reg] = true;
+    cache_done(info, as, src_use);
+    cache_done(info, as, dst_use);
+}
+
+/**
+ * emits the scan itself, see asm_scan.
+ */
+static void asm_scan_loop(asm_info_t *info, x86_as_t *as, const int stride, bool vector) {
+    unsigned size = info->cell_size;
+    unsigned width = (info->simd == AVX2) ? 32 : 16;
+    unsigned step = abs(stride) * size;
+
+    // a vector only pays off when it covers more than one candidate cell,
+    // and there is no compare on 64 bit lanes before SSE4.1.
+    if(!vector || info->simd == SCALAR || step > width / 2 || size == 8) {
+        jump(as, X86_JMP, x86_forward(2));
+        x86_local(as, 1);
+        ins64(as, (stride > 0) ? X86_ADD : X86_SUB, x86_imm(step), reg64(X86_RDI));
+        x86_local(as, 2);
+        x86_ins2(as, X86_CMP, size, x86_imm(0), x86_at(X86_RDI));
+        jump(as, X86_JNE, x86_back(1));
+        return;
+    }
+
+    // compare a window of cells against zero, and mask out every cell that
+    // is not a multiple of the stride away from the data pointer. Forward
+    // scans take the lowest hit in [%rdi, %rdi + width), backward scans the
+    // highest in (%rdi + size - width, %rdi + size]. A zero cell sets the
+    // mask bits of all its bytes, the lowest of which is kept.
+    unsigned lanes = width / step;
+    unsigned mask = 0;
+    for(unsigned i = 0; i < lanes; ++i) {
+        mask |= (stride > 0) ? 1u << (i * step) : 1u << (width - size - i * step);
+    }
+
+    int base = (stride > 0) ? 0 : -(int) (width - size);
+    x86_ins_e pre = (stride > 0) ? X86_SUB : X86_ADD;
+    x86_ins_e adv = (stride > 0) ? X86_ADD : X86_SUB;
+    x86_op_t mask_reg = x86_reg(X86_RAX, 4);
+
+    ins64(as, pre, x86_imm(lanes * step), reg64(X86_RDI));
+    if(info->simd == AVX2) {
+        x86_ins_e cmp = (size == 1) ? X86_VPCMPEQB : (size == 2) ? X86_VPCMPEQW : X86_VPCMPEQD;
+        x86_ins3(as, X86_VPXOR, 0, x86_reg(0, 32), x86_reg(0, 32), x86_reg(0, 32));
+        x86_local(as, 1);
+        ins64(as, adv, x86_imm(lanes * step), reg64(X86_RDI));
+        x86_ins3(as, cmp, 0, x86_mem(X86_RDI, base), x86_reg(0, 32), x86_reg(1, 32));
+        x86_ins2(as, X86_VPMOVMSKB, 0, x86_reg(1, 32), mask_reg);
+    } else {
+        x86_ins_e cmp = (size == 1) ? X86_PCMPEQB : (size == 2) ? X86_PCMPEQW : X86_PCMPEQD;
+        x86_ins2(as, X86_PXOR, 0, x86_reg(0, 16), x86_reg(0, 16));
+        x86_local(as, 1);
+        ins64(as, adv, x86_imm(lanes * step), reg64(X86_RDI));
+        x86_ins2(as, X86_MOVDQU, 0, x86_mem(X86_RDI, base), x86_reg(1, 16));
+        x86_ins2(as, cmp, 0, x86_reg(0, 16), x86_reg(1, 16));
+        x86_ins2(as, X86_PMOVMSKB, 0, x86_reg(1, 16), mask_reg);
+    }
+
+    if(step == 1) x86_ins2(as, X86_TEST, 4, mask_reg, mask_reg);
+    else x86_ins2(as, X86_AND, 4, x86_imm(mask), mask_reg);
+
+    jump(as, X86_JZ, x86_back(1));
+
+    if(stride > 0) {
+        x86_ins2(as, (info->simd == AVX2) ? X86_TZCNT : X86_BSF, 0, mask_reg, mask_reg);
+    } else {
+        x86_ins2(as, X86_BSR, 0, mask_reg, mask_reg);
+    }
+
+    ins64(as, X86_LEA, x86_mem_index(X86_RDI, X86_RAX, 1, base), reg64(X86_RDI));
+    if(info->simd == AVX2) x86_ins0(as, X86_VZEROUPPER);
+}
+
+void asm_scan(asm_info_t *info, x86_as_t *as, const int stride, const unsigned label, bool vector) {
+    assert(stride != 0);
+    cache_flush(info, as);
+
+    if(!counting(info)) {
+        asm_scan_loop(info, as, stride, vector);
+        return;
+    }
+
+    // the iterations of a scan are the cells between where it starts and
+    // where it stops.
+    unsigned shift = (info->cell_size == 8) ? 3 : info->cell_size / 2;
+    asm_count_entry(info, as, label);
+    ins64(as, X86_MOV, reg64(X86_RDI), reg64(X86_RDX));
+    asm_scan_loop(info, as, stride, vector);
+    ins64(as, X86_SUB, reg64(X86_RDI), reg64(X86_RDX));
+    if(stride > 0) x86_ins1(as, X86_NEG, 8, reg64(X86_RDX));
+    if(shift > 0) ins64(as, X86_SHR, x86_imm(shift), reg64(X86_RDX));
+    ins64(as, X86_ADD, reg64(X86_RDX), counter("_bf_prof_counts", 16 * label + 8));
+    if(info->report) ins64(as, X86_ADD, reg64(X86_RDX), counter("_bf_report_insns", 8 * label));
+}
+
+/**
+ * writes the registers back and sets the flags on the current cell, from
+ * its register if it is kept in one.
+ */
+static void asm_test(asm_info_t *info, x86_as_t *as) {
+    cell_use_t *use = cache_use(info, 0);
+    int reg = (use != NULL) ? use->reg : -1;
+    cache_flush(info, as);
+
+    if(reg >= 0) x86_ins2(as, X86_TEST, info->cell_size, cache_reg(info, reg), cache_reg(info, reg));
+    else x86_ins2(as, X86_CMP, info->cell_size, x86_imm(0), x86_at(X86_RDI));
+}
+
+/**
+ * returns the label at the start or the end of a loop, named in buf.
+ */
+static x86_op_t loop_label(char *buf, const unsigned label, bool end) {
+    sprintf(buf, end ? "b_%u_end" : "b_%u_start", label);
+    return x86_sym(buf, 0);
+}
+
+void asm_branch_begin(asm_info_t *info, x86_as_t *as, const unsigned label, bool align) {
+    char name[32];
+    asm_count_entry(info, as, label);
+    asm_test(info, as);
+    jump(as, X86_JE, loop_label(name, label, true));
+    if(align) x86_align(as, 16);
+    x86_label(as, loop_label(name, label, false).sym);
+    asm_count_iteration(info, as, label);
+}
+
+void asm_branch_end(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    char name[32];
+    asm_test(info, as);
+    jump(as, X86_JNE, loop_label(name, label, false));
+    x86_label(as, loop_label(name, label, true).sym);
+}
+
+void asm_branch_exit(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    char name[32];
+    asm_test(info, as);
+    jump(as, X86_JE, loop_label(name, label, true));
+}
+
+void asm_branch_outline(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    char name[32];
+    asm_count_entry(info, as, label);
+    asm_test(info, as);
+    jump(as, X86_JNE, loop_label(name, label, false));
+    x86_label(as, loop_label(name, label, true).sym);
+}
+
+void asm_outline_begin(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    char name[32];
+    x86_label(as, loop_label(name, label, false).sym);
+    asm_count_iteration(info, as, label);
+}
+
+void asm_outline_end(asm_info_t *info, x86_as_t *as, const unsigned label) {
+    char name[32];
+    asm_test(info, as);
+    jump(as, X86_JNE, loop_label(name, label, false));
+    jump(as, X86_JMP, loop_label(name, label, true));
+}
+
+void asm_write(asm_info_t *info, x86_as_t *as, const int offset) {
+    // appends the lowest byte of the cell to the output buffer, flushing
+    // it when full.
+    cell_use_t *use = cache_use(info, offset);
+    int reg = cache_get(info, as, use, true);
+    if(reg >= 0) {
+        x86_ins2(as, X86_MOV, 1, x86_reg(cache_regs[reg], 1), x86_at(X86_R12));
+    } else {
+        x86_ins2(as, X86_MOV, 1, tape_cell(info, offset), x86_reg(X86_RAX, 1));
+        x86_ins2(as, X86_MOV, 1, x86_reg(X86_RAX, 1), x86_at(X86_R12));
+    }
+    cache_done(info, as, use);
+
+    x86_ins1(as, X86_INC, 8, reg64(X86_R12));
+    ins64(as, X86_CMP, x86_imm_sym("_bf_obuf_end", 0), reg64(X86_R12));
+    jump(as, X86_JB, x86_forward(1));
+    call(as, "_bf_flush");
+    x86_local(as, 1);
+}
+
+void asm_read(asm_info_t *info, x86_as_t *as) {
+    cache_flush(info, as);
+    call(as, "_bf_getc");
+}
+
+void asm_comment(x86_as_t *as, char *fmt, ...) {
+    // comments only go into the assembly text.
+    if(as->text == NULL) return;
+
     va_list lst;
     va_start(lst, fmt);
 
-    fprintf(out, "#");
-    vfprintf(out, fmt, lst);
-    fprintf(out, "\n");
+    TEXT_LIT(as->text, "#");
+    text_vprintf(as->text, fmt, lst);
+    TEXT_LIT(as->text, "\n");
 
     va_end(lst);
 }
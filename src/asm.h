@@ -8,36 +8,234 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+#include "profile.h"
+#include "token.h"
+#include "x86.h"
+
+// the number of registers cells can be kept in, and the most instructions
+// a run of straight-line code keeping cells in them covers.
+#define CACHE_REGS 6
+#define CACHE_RUN 64
+
+/**
+ * A cell used more than once in a run of straight-line code, with the
+ * number of uses it has left in it.
+ */
+typedef struct {
+    int offset;
+    int uses;
+
+    // the register the cell is kept in, or -1, which is up to the emitter.
+    int reg;
+} cell_use_t;
+
+/**
+ * The cells of the current run of straight-line code that are kept in
+ * registers instead of on the tape. A register is written back when the
+ * last use of its cell has passed, or when the run ends.
+ */
+typedef struct {
+    // the cells used more than once. Every one of them takes at least two
+    // of the at most two uses per instruction.
+    cell_use_t hot[CACHE_RUN];
+    unsigned hot_count;
+
+    // the cell in each register, or NULL for a free one.
+    cell_use_t *regs[CACHE_REGS];
+    bool dirty[CACHE_REGS];
+} cell_cache_t;
+
 typedef struct {
     int stack_size;
+
+    // the size of a cell in bytes: 1, 2, 4 or 8. Cells wrap around at
+    // their width.
+    int cell_size;
     bool debug;
+
+    // whether the optimized ir of the program is written to stderr.
+    bool dump_ir;
     enum {
         ZERO,
         NEGATIVE,
         UNCHANGED
     } eof_handling;
+    enum {
+        SCALAR,
+        SSE2,
+        AVX2
+    } simd;
+
+    // the number of steps the program may be evaluated for at compile
+    // time, or 0 to not evaluate it.
+    unsigned long eval_steps;
+
+    // whether the optimization passes run at all.
+    bool optimize;
+
+    // the tape is either in .bss, or mapped with guard pages around it
+    // that stop the program, or grow the tape, when they are touched.
+    enum {
+        TAPE_STATIC,
+        TAPE_GUARD,
+        TAPE_GROW
+    } tape;
+    bool tape_hugepages;
+    bool tape_prefault;
+
+    // how far past the last cell it touched the program can reach with a
+    // single instruction, which the guard pages have to cover.
+    int tape_reach;
+
+    // whether cells are kept in registers within straight-line code.
+    bool cache;
+    cell_cache_t cells;
+
+    // the part being compiled, and the constant vectors emitted in it so
+    // far, which name them.
+    unsigned part;
+    unsigned vectors;
+
+    // the number of loop labels in the program. A program built with
+    // profile_generate counts how often each loop runs, and writes the
+    // counts to that file when it exits. The counts of a profile then
+    // decide where the expensive lowerings go, NULL treats every loop as
+    // hot.
+    unsigned loops;
+    const char *profile_generate;
+    profile_t *profile;
+
+    // a program built with report counts the instructions each loop runs,
+    // and writes the busiest loops to stderr when it exits or gets
+    // SIGUSR1. The loops are found in source_name by their ranges in
+    // loop_src, and loop_size is the instructions of an iteration, both by
+    // label from loop_base. top_size is the instructions outside of loops.
+    bool report;
+    const char *source_name;
+    const srcrange_t *loop_src;
+    const unsigned *loop_size;
+    unsigned loop_base;
+    unsigned long top_size;
+
+    // a source compiled as a stream is tokenized, optimized and emitted in
+    // parts of about stream_window tokens, each ending outside of all
+    // loops, or at once when it is 0. preceded and followed tell whether
+    // other parts run before and after the one being compiled: only the
+    // first can assume a blank tape, and all but the last have to leave
+    // the data pointer where the program has it.
+    unsigned stream_window;
+    bool preceded;
+    bool followed;
+
+    // the threads the parts are compiled on at once, which does not change
+    // the output.
+    unsigned threads;
+
+    // whether the program is written as c instead of assembly, from the
+    // same optimized ir. Only the options of the ir, the cells and the
+    // tape size apply to it.
+    bool emit_c;
 } asm_info_t;
 
-void asm_move(asm_info_t *info, FILE *out, const int offset);
-void asm_diff(asm_info_t *info, FILE *out, const int diff);
-void asm_set(asm_info_t *info, FILE *out, const int value);
+/**
+ * The state of the program at the point the generated code starts at,
+ * as found by evaluating it at compile time.
+ */
+typedef struct {
+    // the index of the first ir instruction that was not evaluated.
+    unsigned resume;
+
+    // the data pointer, and the cells in [low, high), relative to the
+    // middle of the tape. cells is the image of them in memory, of
+    // (high - low) * cell_size bytes.
+    int ptr;
+    int low;
+    int high;
+    unsigned char *cells;
+
+    // everything the program wrote before resume.
+    unsigned char *output;
+    size_t output_len;
+} prefix_t;
+
+/**
+ * starts a run of straight-line code, in which the cells in hot are used
+ * more than once and may be kept in registers. The run ends at the next
+ * move, scan, read, loop or label, or the next plan, which write every
+ * register back first.
+ */
+void asm_cache_plan(asm_info_t *info, x86_as_t *as, const cell_use_t *hot, unsigned count);
+
+/**
+ * Cells are addressed with an offset relative to the data pointer.
+ */
+void asm_move(asm_info_t *info, x86_as_t *as, const int offset);
+void asm_diff(asm_info_t *info, x86_as_t *as, const int offset, const int diff);
+void asm_set(asm_info_t *info, x86_as_t *as, const int offset, const int value);
+
+/**
+ * returns the number of adjacent cells a vector covers, or 0 when there
+ * are no vectors or they cover too few cells to be worth it.
+ */
+unsigned asm_vector_cells(asm_info_t *info);
+
+/**
+ * adds to or sets count adjacent cells from offset at once, a multiple of
+ * the cells of a vector. values holds the difference or value of each
+ * cell, and sets tells which of them are set.
+ */
+void asm_vector(asm_info_t *info, x86_as_t *as, const int offset, const unsigned count, const int *values, const bool *sets);
+
+/**
+ * Adds the value of the cell at src to the cell at dst.
+ */
+void asm_copy(asm_info_t *info, x86_as_t *as, const int src, const int dst);
+
+/**
+ * performs a multiplication of the cell at src with factor and adds the
+ * result to the cell at dst.
+ */
+void asm_mult(asm_info_t *info, x86_as_t *as, const int factor, const int src, const int dst);
+
+/**
+ * moves the data pointer by stride until it points at a zero cell,
+ * equivalent to a loop only containing a move. Only a vector scan uses
+ * simd instructions.
+ */
+void asm_scan(asm_info_t *info, x86_as_t *as, const int stride, const unsigned label, bool vector);
+void asm_header(asm_info_t *info, x86_as_t *as);
+void asm_footer(asm_info_t *info, x86_as_t *as);
+
+/**
+ * restores the state of an evaluated prefix at startup and continues at
+ * the resume label, which must be emitted with asm_resume.
+ */
+void asm_prefix(asm_info_t *info, x86_as_t *as, const prefix_t *prefix);
+void asm_resume(asm_info_t *info, x86_as_t *as);
+void asm_write(asm_info_t *info, x86_as_t *as, const int offset);
+void asm_read(asm_info_t *info, x86_as_t *as);
+
+/**
+ * A loop is a test at the beginning and the end. The head of an aligned
+ * loop starts on a 16 byte boundary.
+ */
+void asm_branch_begin(asm_info_t *info, x86_as_t *as, const unsigned label, bool align);
+void asm_branch_end(asm_info_t *info, x86_as_t *as, const unsigned label);
 
 /**
- * Performs a copy of the value at the current cell into another cell with
- * offset.
+ * leaves a loop from the middle of its body, between the copies of an
+ * unrolled one.
  */
-void asm_copy(asm_info_t *info, FILE *out, const int offset);
+void asm_branch_exit(asm_info_t *info, x86_as_t *as, const unsigned label);
 
 /**
- * performs a multiplication to the current cell value with factor and
- * stores the result in a cell with offset.
+ * Loops that are rarely entered are laid out after the rest of the
+ * program, so they do not take up room in between. asm_branch_outline
+ * takes the place of the loop, and the body is emitted later between
+ * asm_outline_begin and asm_outline_end.
  */
-void asm_mult(asm_info_t *info, FILE *out, const int factor, const int offset);
-void asm_header(asm_info_t *info, FILE *out);
-void asm_footer(asm_info_t *info, FILE *out);
-void asm_write(asm_info_t *info, FILE *out);
-void asm_read(asm_info_t *info, FILE *out);
-void asm_branch_begin(asm_info_t *info, FILE *out, const char *name);
-void asm_branch_end(asm_info_t *info, FILE *out, const char *name);
+void asm_branch_outline(asm_info_t *info, x86_as_t *as, const unsigned label);
+void asm_outline_begin(asm_info_t *info, x86_as_t *as, const unsigned label);
+void asm_outline_end(asm_info_t *info, x86_as_t *as, const unsigned label);
 
-void asm_comment(asm_info_t *info, FILE *out, char *fmt, ...);
+void asm_comment(x86_as_t *as, char *fmt, ...);
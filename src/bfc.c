@@ -12,30 +12,74 @@
 #include <unistd.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <ctype.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 
 #include "token.h"
 #include "parser.h"
+#include "cache.h"
+#include "jit.h"
+#include "elfout.h"
+#include "interp.h"
 #include "err.h"
+#include "timer.h"
 
 #define VERSION "0.1.1"
 
 void help(FILE *fp, char *const cmd);
 void version(FILE *fp);
 
-pid_t spawn_parser(asm_info_t *info, FILE *in, int *pipe);
-pid_t spawn_assembler(asm_info_t *info, int in_fd, const char *outfile);
+FILE *open_output(const char *outfile, bool executable);
+FILE *open_source(const char *infile);
+void read_source(const char *infile, toklist_t *tokens);
+void assemble_source(asm_info_t *info, const char *infile, x86_obj_t *obj);
+void write_output(asm_info_t *info, const char *infile, const char *outfile, bool assemble, bool executable);
+void compile(asm_info_t *info, cache_t *cache, const char *infile, const char *outfile, bool assemble, bool executable);
+int compile_all(asm_info_t *info, cache_t *cache, char *const *infiles, unsigned count, unsigned jobs, bool assemble, bool executable);
+char *output_name(const asm_info_t *info, const char *infile, bool assemble, bool executable);
+void expand_args(int *argc, char ***argv);
+unsigned parse_jobs(const char *arg);
+void parse_feature(asm_info_t *info, cache_t *cache, const char *feature);
+void parse_target(asm_info_t *info, const char *target);
 
 #include "token.h"
 
-int main(const int argc, char *const *argv) {
+int main(int argc, char **argv) {
 
-    char *outfile = "a.out";
+    char *outfile = NULL;
     bool assemble = true;
-    bool debug = false;
+    bool run = false;
+    bool interpret = false;
+    bool executable = false;
+
+    // several files are compiled on as many workers as there are cpus.
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned jobs = (cpus > 0) ? cpus : 1;
+
+    // a read at end of input leaves the cell as is unless told otherwise.
+    asm_info_t info = {
+        .stack_size = 30000,
+        .cell_size = 1,
+        .debug = false,
+        .eof_handling = UNCHANGED,
+        .simd = SSE2,
+        .eval_steps = 1 << 24,
+        .optimize = true,
+        .cache = true,
+        .tape = TAPE_STATIC
+    };
+
+    // outputs are only cached in a directory given with -fcompile-cache.
+    cache_t cache = { .dir = NULL, .max_size = CACHE_DEFAULT_SIZE };
+
+    expand_args(&argc, &argv);
 
     int opt;
-    while((opt = getopt(argc, argv, "hvgSo:")) != -1) {
+    while((opt = getopt(argc, argv, "hvgpSrixo:f:m:j:")) != -1) {
         switch ((char) opt) {
         case 'o':
             outfile = optarg;
@@ -43,8 +87,29 @@ int main(const int argc, char *const *argv) {
         case 'S':
             assemble = false;
             break;
+        case 'r':
+            run = true;
+            break;
+        case 'i':
+            interpret = true;
+            break;
+        case 'x':
+            executable = true;
+            break;
         case 'g':
-            debug = true;
+            info.debug = true;
+            break;
+        case 'p':
+            info.report = true;
+            break;
+        case 'f':
+            parse_feature(&info, &cache, optarg);
+            break;
+        case 'm':
+            parse_target(&info, optarg);
+            break;
+        case 'j':
+            jobs = parse_jobs(optarg);
             break;
 
         case 'h':
@@ -59,19 +124,84 @@ int main(const int argc, char *const *argv) {
         }
     }
 
-    char *infile = argv[optind];
+    // the parts of a single file are compiled on as many threads as there
+    // are jobs.
+    info.threads = jobs;
 
-    if(argc > optind + 1) {
-        fprintf(stderr, "too many arguments: one expected\n");
-        help(stderr, argv[0]);
-        exit(EXIT_FAILURE);
+    // only a mapped tape can use huge pages or be faulted in up front.
+    if((info.tape_hugepages || info.tape_prefault) && info.tape == TAPE_STATIC) {
+        info.tape = TAPE_GUARD;
     }
+
+    if(info.profile_generate != NULL && info.profile != NULL) {
+        error("-fprofile-generate and -fprofile-use can not be combined");
+    }
+    if(info.profile_generate != NULL && interpret) {
+        error("-fprofile-generate needs generated code, not the interpreter");
+    }
+    if(info.report && interpret) error("-p needs generated code, not the interpreter");
+
+    // c is written like assembly, and only compiled by a c compiler.
+    if(info.emit_c) {
+        if(run || interpret) error("-r and -i run the program instead of writing it as c");
+        if(executable) error("-femit-c writes c, which a c compiler makes an executable");
+        if(info.profile_generate != NULL || info.report) {
+            error("-fprofile-generate and -p need generated assembly, not c");
+        }
+        assemble = false;
+    }
+
     if(argc <= optind) {
         fprintf(stderr, "expected a file to compile\n");
         help(stderr, argv[0]);
         exit(EXIT_FAILURE);
     }
 
+    unsigned count = argc - optind;
+    if(count > 1) {
+        if(outfile != NULL) error("-o names the output of a single file");
+        if(run || interpret) error("-r and -i run a single file");
+
+        int status = compile_all(&info, &cache, argv + optind, count, jobs, assemble, executable);
+        if(cache.dir != NULL && cache.stats) cache_report(&cache, stderr);
+        if(info.profile != NULL) profile_free(info.profile);
+        free(info.profile);
+        return status;
+    }
+
+    char *infile = argv[optind];
+
+    if(interpret || run) {
+        info.source_name = infile;
+        if(!interpret) {
+            x86_obj_t obj;
+            assemble_source(&info, infile, &obj);
+            jit_run(&obj);
+        }
+
+        toklist_t tokens = TOKLIST_INIT;
+        read_source(infile, &tokens);
+
+        int status = interp_run(&info, &tokens);
+        toklist_free(&tokens);
+        if(info.profile != NULL) profile_free(info.profile);
+        free(info.profile);
+        return status;
+    }
+
+    compile(&info, &cache, infile, (outfile != NULL) ? outfile : "a.out", assemble, executable);
+    if(cache.dir != NULL && cache.stats) cache_report(&cache, stderr);
+
+    if(info.profile != NULL) profile_free(info.profile);
+    free(info.profile);
+    timer_report(stderr);
+    return 0;
+}
+
+/**
+ * opens a source file, which must not be empty.
+ */
+FILE *open_source(const char *infile) {
     FILE *fp = fopen(infile, "r");
     if(fp == NULL) sys_error("fopen '%s' failed", infile);
 
@@ -79,84 +209,435 @@ int main(const int argc, char *const *argv) {
     int c = fgetc(fp);
     if(c == EOF) error("no input to compile, exiting.");
     ungetc(c, fp);
+    return fp;
+}
 
-    asm_info_t info = {
-        .stack_size = 30000,
-        .debug = debug,
-        .eof_handling = ZERO
-    };
+/**
+ * reads and tokenizes a source file.
+ */
+void read_source(const char *infile, toklist_t *tokens) {
+    FILE *fp = open_source(infile);
+    tokenize(tokens, fp);
+    fclose(fp);
+    timer_mark("tokenize");
+}
 
-    if(assemble) {
-        int p[2];
-        if(pipe(p) == -1) sys_error("pipe");
+/**
+ * compiles and assembles a source file into an object. A streamed source
+ * is compiled as it is read.
+ */
+void assemble_source(asm_info_t *info, const char *infile, x86_obj_t *obj) {
+    if(info->stream_window > 0) {
+        FILE *in = open_source(infile);
+        parse_stream_object(info, in, obj);
+        fclose(in);
+        return;
+    }
+
+    toklist_t tokens = TOKLIST_INIT;
+    read_source(infile, &tokens);
+    parse_object(info, &tokens, obj);
+    toklist_free(&tokens);
+}
+
+/**
+ * compiles a source file to assembly, or to an object or executable when
+ * assemble is set, and writes it to outfile.
+ */
+void write_output(asm_info_t *info, const char *infile, const char *outfile, bool assemble, bool executable) {
+    if(info->emit_c) {
+        toklist_t tokens = TOKLIST_INIT;
+        read_source(infile, &tokens);
 
-        pid_t pid_parser = spawn_parser(&info, fp, p);
-        pid_t pid_asm = spawn_assembler(&info, p[0], outfile);
+        FILE *out = open_output(outfile, false);
+        parse_c(info, &tokens, out);
+        if(fclose(out) != 0) sys_error("fclose %s", outfile);
+        timer_mark("write");
+        toklist_free(&tokens);
+    } else if(assemble) {
+        x86_obj_t obj;
+        assemble_source(info, infile, &obj);
+
+        FILE *out = open_output(outfile, executable);
+        if(executable) elf_write_executable(&obj, out);
+        else elf_write_object(&obj, out);
+        if(fclose(out) != 0) sys_error("fclose %s", outfile);
+        timer_mark("write");
 
-        int parser_rc, asm_rc;
-        if(waitpid(pid_parser, &parser_rc, 0) == -1) sys_error("wait parser");
-        if(waitpid(pid_asm, &asm_rc, 0) == -1) sys_error("wait assembler");
+        x86_free(&obj);
+    } else if(info->stream_window > 0) {
+        FILE *in = open_source(infile);
+        FILE *out = open_output(outfile, false);
+        parse_stream(info, in, out);
+        if(fclose(out) != 0) sys_error("fclose %s", outfile);
+        fclose(in);
+        timer_mark("write");
     } else {
-        FILE *out = fopen(outfile, "w");
-        if(out == NULL) sys_error("fopen %s", outfile);
-        
         toklist_t tokens = TOKLIST_INIT;
-        tokenize(&tokens, fp);
-        fclose(fp);
+        read_source(infile, &tokens);
 
-        parse(&info, &tokens, out);
+        FILE *out = open_output(outfile, false);
+        parse(info, &tokens, out);
+        if(fclose(out) != 0) sys_error("fclose %s", outfile);
+        timer_mark("write");
         toklist_free(&tokens);
     }
+}
 
-    return 0;
+/**
+ * compiles a source file and writes it to outfile, or copies the output
+ * of an earlier compile of the same instructions with the same options
+ * from the cache, which skips every phase. -fdump-ir always compiles, as
+ * the ir comes from those phases, but the output is stored all the same.
+ */
+void compile(asm_info_t *info, cache_t *cache, const char *infile, const char *outfile, bool assemble, bool executable) {
+    info->source_name = infile;
+
+    cache_key_t key;
+    if(cache->dir != NULL) {
+        key = cache_key(info, infile, VERSION, assemble, executable);
+        FILE *cached = info->dump_ir ? NULL : cache_find(cache, &key);
+        timer_mark("cache");
+
+        if(cached != NULL) {
+            FILE *out = open_output(outfile, executable);
+            char buf[65536];
+            size_t n;
+            while((n = fread(buf, 1, sizeof buf, cached)) > 0) {
+                if(fwrite(buf, 1, n, out) != n) sys_error("write %s", outfile);
+            }
+            if(ferror(cached)) sys_error("read cached output");
+            fclose(cached);
+            if(fclose(out) != 0) sys_error("fclose %s", outfile);
+            timer_mark("write");
+            return;
+        }
+    }
+
+    write_output(info, infile, outfile, assemble, executable);
+
+    if(cache->dir != NULL) {
+        cache_store(cache, &key, outfile);
+        timer_mark("cache");
+    }
 }
 
-pid_t spawn_parser(asm_info_t *info, FILE *in, int *pipe) {
-    pid_t pid = fork();
-    switch (pid) {
-    case -1: sys_error("fork parser");
-    case 0:
-        close(pipe[0]);
-        FILE *out = fdopen(pipe[1], "w");
-        if(out == NULL) sys_error("fdopen pipe write-end");
+/**
+ * compiles several files, each in a worker process of its own so an error
+ * in one file only stops that file. At most jobs workers run at once.
+ * Returns the exit status of the whole batch.
+ */
+int compile_all(asm_info_t *info, cache_t *cache, char *const *infiles, unsigned count, unsigned jobs, bool assemble, bool executable) {
+    pid_t *pids = malloc(count * sizeof *pids);
+    if(pids == NULL) sys_error("malloc workers");
 
-        // tokenize
-        toklist_t tokens = TOKLIST_INIT;
-        tokenize(&tokens, in);
-        fclose(in);
+    unsigned started = 0, running = 0, failed = 0;
+    while(started < count || running > 0) {
+        if(started < count && running < jobs) {
+            // nothing buffered may be written twice.
+            fflush(NULL);
+            pid_t pid = fork();
+            if(pid == -1) sys_error("fork");
 
-        parse(info, &tokens, out);
-        toklist_free(&tokens);
-        fclose(out);
+            if(pid == 0) {
+                const char *infile = infiles[started];
+                error_context(infile);
+                info->threads = 1;
+                compile(info, cache, infile, output_name(info, infile, assemble, executable), assemble, executable);
+                timer_report(stderr);
+                exit(EXIT_SUCCESS);
+            }
+
+            pids[started++] = pid;
+            running++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if(pid == -1) sys_error("wait");
+        running--;
+
+        unsigned i = 0;
+        while(i < started && pids[i] != pid) i++;
+        if(WIFSIGNALED(status)) {
+            fprintf(stderr, "%s: killed by signal %d\n", infiles[i], WTERMSIG(status));
+        }
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+
+    free(pids);
+    if(failed > 0) {
+        fprintf(stderr, "%u of %u files failed to compile\n", failed, count);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * returns the name of the output of a source file compiled with others,
+ * which is the source with its extension replaced: .c for c, .s for
+ * assembly, .o for an object, and none for an executable. An executable
+ * from a source without an extension is named with .out.
+ */
+char *output_name(const asm_info_t *info, const char *infile, bool assemble, bool executable) {
+    const char *ext = info->emit_c ? ".c" : !assemble ? ".s" : executable ? "" : ".o";
+    const char *base = strrchr(infile, '/');
+    const char *dot = strrchr((base != NULL) ? base : infile, '.');
+
+    size_t len = (dot != NULL && dot != base + 1 && dot != infile) ? (size_t) (dot - infile) : strlen(infile);
+    if(len == strlen(infile) && executable) ext = ".out";
+
+    char *name = malloc(len + strlen(ext) + 1);
+    if(name == NULL) sys_error("malloc output name");
+    memcpy(name, infile, len);
+    strcpy(name + len, ext);
+    return name;
+}
+
+/**
+ * replaces every argument @file with the arguments in file, which are
+ * separated by whitespace. Response files in a response file are not
+ * expanded.
+ */
+void expand_args(int *argc, char ***argv) {
+    int count = 0, capacity = *argc + 1;
+    char **args = malloc(capacity * sizeof *args);
+    if(args == NULL) sys_error("malloc arguments");
+
+    for(int i = 0; i < *argc; ++i) {
+        if(i == 0 || (*argv)[i][0] != '@') {
+            args[count++] = (*argv)[i];
+            continue;
+        }
 
-        exit(EXIT_SUCCESS);
+        const char *path = (*argv)[i] + 1;
+        FILE *fp = fopen(path, "r");
+        if(fp == NULL) sys_error("fopen response file '%s'", path);
+
+        char *text = NULL;
+        size_t len = 0;
+        if(getdelim(&text, &len, '\0', fp) == -1 && ferror(fp)) sys_error("read response file '%s'", path);
+        fclose(fp);
+        if(text == NULL) continue;
+
+        // the arguments are split in place, the text is kept for them.
+        for(char *c = text; *c != '\0';) {
+            while(isspace((unsigned char) *c)) *c++ = '\0';
+            if(*c == '\0') break;
+
+            if(count + 1 >= capacity) {
+                capacity *= 2;
+                args = realloc(args, capacity * sizeof *args);
+                if(args == NULL) sys_error("realloc arguments");
+            }
+            args[count++] = c;
+            while(*c != '\0' && !isspace((unsigned char) *c)) c++;
+        }
     }
 
-    fclose(in);
+    args[count] = NULL;
+    *argc = count;
+    *argv = args;
+}
 
-    close(pipe[1]);
-    return pid;
+/**
+ * Parses the number of workers of -j.
+ */
+unsigned parse_jobs(const char *arg) {
+    char *end;
+    long jobs = strtol(arg, &end, 10);
+    if(*end != '\0' || end == arg || jobs <= 0 || jobs > INT_MAX) error("invalid job count '-j%s'", arg);
+    return jobs;
 }
 
-pid_t spawn_assembler(asm_info_t *info, int in_fd, const char *outfile) {
-    pid_t pid = fork();
-    switch (pid) {
-    case -1: sys_error("fork assembler");
-    case 0:
-        dup2(in_fd, STDIN_FILENO);
-        execlp("as", "--64", "-g", "-o", outfile, NULL);
-        sys_error("execlp assembler");
-    }
-    
-    close(in_fd);
-    return pid;
+/**
+ * opens the output file. Executables are created anew with execute
+ * permissions, as far as the umask allows, unless the output is not a
+ * regular file, such as a pipe.
+ */
+FILE *open_output(const char *outfile, bool executable) {
+    if(!executable) {
+        FILE *out = fopen(outfile, "w");
+        if(out == NULL) sys_error("fopen %s", outfile);
+        return out;
+    }
+
+    struct stat st;
+    if(stat(outfile, &st) == 0 && S_ISREG(st.st_mode)) unlink(outfile);
+    int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    if(fd == -1) sys_error("open %s", outfile);
+
+    FILE *out = fdopen(fd, "w");
+    if(out == NULL) sys_error("fdopen %s", outfile);
+    return out;
+}
+
+/**
+ * Parses a -f feature flag into the assembly options.
+ */
+void parse_feature(asm_info_t *info, cache_t *cache, const char *feature) {
+    if(strcmp(feature, "eof=zero") == 0) {
+        info->eof_handling = ZERO;
+    } else if(strcmp(feature, "eof=negative") == 0) {
+        info->eof_handling = NEGATIVE;
+    } else if(strcmp(feature, "eof=unchanged") == 0) {
+        info->eof_handling = UNCHANGED;
+    } else if(strncmp(feature, "eval-steps=", 11) == 0) {
+        char *end;
+        info->eval_steps = strtoul(feature + 11, &end, 10);
+        if(*end != '\0' || end == feature + 11) error("invalid step count '-f%s'", feature);
+    } else if(strcmp(feature, "no-eval") == 0) {
+        info->eval_steps = 0;
+    } else if(strcmp(feature, "no-opt") == 0) {
+        info->optimize = false;
+    } else if(strcmp(feature, "no-cache") == 0) {
+        info->cache = false;
+    } else if(strcmp(feature, "profile-generate") == 0) {
+        info->profile_generate = PROFILE_DEFAULT_PATH;
+    } else if(strncmp(feature, "profile-generate=", 17) == 0 && feature[17] != '\0') {
+        info->profile_generate = feature + 17;
+    } else if(strcmp(feature, "profile-use") == 0 || (strncmp(feature, "profile-use=", 12) == 0 && feature[12] != '\0')) {
+        if(info->profile == NULL) info->profile = malloc(sizeof *info->profile);
+        else profile_free(info->profile);
+        if(info->profile == NULL) sys_error("malloc profile");
+        profile_load(info->profile, (feature[11] == '=') ? feature + 12 : PROFILE_DEFAULT_PATH);
+    } else if(strncmp(feature, "compile-cache=", 14) == 0 && feature[14] != '\0') {
+        cache->dir = feature + 14;
+    } else if(strncmp(feature, "compile-cache-size=", 19) == 0) {
+        char *end;
+        unsigned long long size = strtoull(feature + 19, &end, 10);
+        int shift = (*end == 'k') ? 10 : (*end == 'M') ? 20 : (*end == 'G') ? 30 : 0;
+        if(shift > 0) end++;
+        if(*end != '\0' || end == feature + 19 || size > (UINT64_MAX >> shift)) {
+            error("invalid cache size '-f%s'", feature);
+        }
+        cache->max_size = size << shift;
+    } else if(strcmp(feature, "compile-cache-stats") == 0) {
+        cache->stats = true;
+    } else if(strcmp(feature, "stream") == 0) {
+        info->stream_window = STREAM_WINDOW;
+    } else if(strncmp(feature, "stream=", 7) == 0) {
+        char *end;
+        unsigned long window = strtoul(feature + 7, &end, 10);
+        if(*end != '\0' || end == feature + 7 || window == 0 || window > UINT_MAX) {
+            error("invalid stream window '-f%s'", feature);
+        }
+        info->stream_window = window;
+    } else if(strcmp(feature, "emit-c") == 0) {
+        info->emit_c = true;
+    } else if(strcmp(feature, "dump-ir") == 0) {
+        info->dump_ir = true;
+    } else if(strcmp(feature, "time-report") == 0) {
+        timer_enable();
+    } else if(strcmp(feature, "cell-width=8") == 0) {
+        info->cell_size = 1;
+    } else if(strcmp(feature, "cell-width=16") == 0) {
+        info->cell_size = 2;
+    } else if(strcmp(feature, "cell-width=32") == 0) {
+        info->cell_size = 4;
+    } else if(strcmp(feature, "cell-width=64") == 0) {
+        info->cell_size = 8;
+    } else if(strcmp(feature, "tape=static") == 0) {
+        info->tape = TAPE_STATIC;
+    } else if(strcmp(feature, "tape=guard") == 0) {
+        info->tape = TAPE_GUARD;
+    } else if(strcmp(feature, "tape=grow") == 0) {
+        info->tape = TAPE_GROW;
+    } else if(strncmp(feature, "tape-size=", 10) == 0) {
+        char *end;
+        long size = strtol(feature + 10, &end, 10);
+        if(*end != '\0' || end == feature + 10 || size <= 0 || size > INT_MAX / 2) {
+            error("invalid tape size '-f%s'", feature);
+        }
+        info->stack_size = size;
+    } else if(strcmp(feature, "tape-hugepages") == 0) {
+        info->tape_hugepages = true;
+    } else if(strcmp(feature, "tape-prefault") == 0) {
+        info->tape_prefault = true;
+    } else {
+        error("unknown feature '-f%s'", feature);
+    }
+}
+
+/**
+ * Parses a -m target flag, selecting the instruction set of the output.
+ */
+void parse_target(asm_info_t *info, const char *target) {
+    if(strcmp(target, "scalar") == 0) {
+        info->simd = SCALAR;
+    } else if(strcmp(target, "sse2") == 0) {
+        info->simd = SSE2;
+    } else if(strcmp(target, "avx2") == 0) {
+        info->simd = AVX2;
+    } else {
+        error("unknown target '-m%s'", target);
+    }
 }
 
 void help(FILE *fp, char *const cmd) {
-    fprintf(fp, "usage: %s [-gShv] [-o out_file] file\n"
+    fprintf(fp, "usage: %s [-gpSrixhv] [-f feature] [-m target] [-j jobs] [-o out_file] file...\n"
         "  S        skips the assembler and only outputs the generated assembly.\n"
+        "  r        runs the program directly instead of writing a file.\n"
+        "  i        runs the program in an interpreter instead.\n"
         "  g        generates assembly with comments about the bf instructions.\n"
-        "  o file   the file to write the assembly/linkable object to.\n"
+        "  p        counts the instructions each loop runs, and writes the\n"
+        "           busiest loops to stderr at exit or on SIGUSR1.\n"
+        "  x        writes a static executable instead of a linkable object.\n"
+        "  o file   the file to write the assembly/object/executable to.\n"
+        "  j jobs   the files compiled at once when given several, which are\n"
+        "           each written next to their source, or the threads the parts\n"
+        "           of a single file are compiled on (default the cpus).\n"
+        "  @file    reads more arguments from file.\n"
+        "  f eof=zero|negative|unchanged\n"
+        "           sets the cell on a read at end of input (default unchanged).\n"
+        "  f eval-steps=n|no-eval\n"
+        "           evaluates up to n instructions before the first read at\n"
+        "           compile time (default 16777216).\n"
+        "  f no-opt skips the optimization passes.\n"
+        "  f no-cache\n"
+        "           keeps every cell on the tape instead of keeping the ones\n"
+        "           used repeatedly in straight-line code in registers.\n"
+        "  f cell-width=8|16|32|64\n"
+        "           the bits in a cell, which wraps around (default 8).\n"
+        "  f tape=static|guard|grow\n"
+        "           keeps the tape in the executable, or maps it with guard\n"
+        "           pages that stop the program or grow the tape when the\n"
+        "           data pointer leaves it (default static).\n"
+        "  f tape-size=n\n"
+        "           the number of cells on either side of the starting cell\n"
+        "           (default 30000).\n"
+        "  f tape-hugepages, tape-prefault\n"
+        "           maps the tape with huge pages, or faults it in at startup.\n"
+        "  f profile-generate[=file]\n"
+        "           counts how often each loop runs, and writes the counts to\n"
+        "           file when the program exits (default bfc.prof).\n"
+        "  f profile-use[=file]\n"
+        "           aligns, unrolls, vectorizes and keeps cells in registers\n"
+        "           only in the loops the profile shows to be hot, and moves\n"
+        "           loops that never ran out of the way (default bfc.prof).\n"
+        "  f compile-cache=dir\n"
+        "           copies the output from dir when the same instructions were\n"
+        "           compiled with the same options before, and stores it there\n"
+        "           otherwise.\n"
+        "  f compile-cache-size=n[k|M|G]\n"
+        "           the bytes the cache may hold, after which the least recently\n"
+        "           used outputs are removed (default 256M).\n"
+        "  f compile-cache-stats\n"
+        "           writes the hits, misses and size of the cache to stderr.\n"
+        "  f stream[=n]\n"
+        "           compiles the source as it is read, in parts of about n\n"
+        "           tokens outside of loops, so memory depends on the largest\n"
+        "           part instead of the whole source (default 65536).\n"
+        "  f emit-c writes the program as c instead of assembly, for a c\n"
+        "           compiler to optimize further or to build on other hosts.\n"
+        "  f dump-ir\n"
+        "           writes the optimized instructions to stderr.\n"
+        "  f time-report\n"
+        "           writes the time spent in each phase to stderr.\n"
+        "  m scalar|sse2|avx2\n"
+        "           the vector instructions scan loops and runs of adjacent cells\n"
+        "           may use (default sse2).\n"
         "  h        shows this.\n"
         "  v        shows the version of the program.\n\n"
         "Report bugs to: olle@logdahl.net\n"
@@ -0,0 +1,332 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "err.h"
+
+// the outputs are named by their key in hex.
+#define KEY_CHARS 32
+
+// the file the hits and misses are counted in.
+#define STATS_FILE "stats"
+
+#define COPY_SIZE 65536
+
+static const bool is_instr[256] = {
+    ['+'] = true, ['-'] = true, ['<'] = true, ['>'] = true,
+    ['['] = true, [']'] = true, ['.'] = true, [','] = true
+};
+
+/**
+ * FNV-1a with 128 bits. The prime is 2^88 + 0x13b, so the product is
+ * built from a shift and a small multiplication.
+ */
+static void hash_bytes(cache_key_t *key, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for(size_t i = 0; i < len; ++i) {
+        key->lo ^= bytes[i];
+
+        uint64_t low = (key->lo & 0xffffffff) * 0x13b;
+        uint64_t high = (key->lo >> 32) * 0x13b;
+        uint64_t lo = low + (high << 32);
+        uint64_t carry = (high >> 32) + (lo < low);
+
+        key->hi = key->hi * 0x13b + carry + (key->lo << 24);
+        key->lo = lo;
+    }
+}
+
+static void hash_u64(cache_key_t *key, uint64_t value) {
+    unsigned char bytes[8];
+    for(int i = 0; i < 8; ++i) bytes[i] = value >> (8 * i);
+    hash_bytes(key, bytes, sizeof bytes);
+}
+
+static void hash_str(cache_key_t *key, const char *str) {
+    if(str == NULL) {
+        hash_u64(key, UINT64_MAX);
+        return;
+    }
+
+    hash_u64(key, strlen(str));
+    hash_bytes(key, str, strlen(str));
+}
+
+/**
+ * hashes everything in the options that changes the output.
+ */
+static void hash_info(cache_key_t *key, const asm_info_t *info) {
+    hash_u64(key, info->stack_size);
+    hash_u64(key, info->cell_size);
+    hash_u64(key, info->debug);
+    hash_u64(key, info->eof_handling);
+    hash_u64(key, info->simd);
+    hash_u64(key, info->eval_steps);
+    hash_u64(key, info->optimize);
+    hash_u64(key, info->tape);
+    hash_u64(key, info->tape_hugepages);
+    hash_u64(key, info->tape_prefault);
+    hash_u64(key, info->cache);
+    hash_u64(key, info->report);
+    hash_u64(key, info->stream_window);
+    hash_u64(key, info->emit_c);
+    hash_str(key, info->profile_generate);
+
+    hash_u64(key, info->profile != NULL);
+    if(info->profile != NULL) {
+        hash_u64(key, info->profile->count);
+        hash_bytes(key, info->profile->entries, info->profile->count * sizeof *info->profile->entries);
+        hash_bytes(key, info->profile->iterations, info->profile->count * sizeof *info->profile->iterations);
+    }
+}
+
+cache_key_t cache_key(const asm_info_t *info, const char *infile, const char *version, bool assemble, bool executable) {
+    cache_key_t key = { .hi = 0x6c62272e07bb0142, .lo = 0x62b821756295c58d };
+    hash_str(&key, version);
+    hash_u64(&key, assemble);
+    hash_u64(&key, executable);
+    hash_info(&key, info);
+
+    // the report names the file and the lines and columns of the loops,
+    // so the comments count then.
+    bool whole = info->report;
+    if(whole) hash_str(&key, info->source_name);
+
+    FILE *fp = fopen(infile, "rb");
+    if(fp == NULL) sys_error("fopen '%s' failed", infile);
+
+    unsigned char *buf = malloc(COPY_SIZE);
+    if(buf == NULL) sys_error("malloc source block");
+
+    size_t n;
+    while((n = fread(buf, 1, COPY_SIZE, fp)) > 0) {
+        if(whole) {
+            hash_bytes(&key, buf, n);
+            continue;
+        }
+
+        size_t len = 0;
+        for(size_t i = 0; i < n; ++i) {
+            if(is_instr[buf[i]]) buf[len++] = buf[i];
+        }
+        hash_bytes(&key, buf, len);
+    }
+    if(ferror(fp)) sys_error("read '%s'", infile);
+
+    free(buf);
+    fclose(fp);
+    return key;
+}
+
+/**
+ * returns the path of a file in the cache directory, which the caller
+ * frees.
+ */
+static char *cache_path(const cache_t *cache, const char *name) {
+    char *path = malloc(strlen(cache->dir) + strlen(name) + 2);
+    if(path == NULL) sys_error("malloc cache path");
+    sprintf(path, "%s/%s", cache->dir, name);
+    return path;
+}
+
+static char *entry_path(const cache_t *cache, const cache_key_t *key) {
+    char name[KEY_CHARS + 1];
+    sprintf(name, "%016llx%016llx", (unsigned long long) key->hi, (unsigned long long) key->lo);
+    return cache_path(cache, name);
+}
+
+/**
+ * returns whether a file in the cache directory is a cached output.
+ */
+static bool is_entry(const char *name) {
+    if(strlen(name) != KEY_CHARS) return false;
+    return strspn(name, "0123456789abcdef") == KEY_CHARS;
+}
+
+/**
+ * adds to the hits and misses in the stats file, and reads them. The file
+ * is locked while it is updated, as compiles may share the cache.
+ */
+static void count_stats(const cache_t *cache, uint64_t hits, uint64_t misses, uint64_t *total_hits, uint64_t *total_misses) {
+    char *path = cache_path(cache, STATS_FILE);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd == -1) sys_error("open '%s'", path);
+
+    struct flock lock = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    if(fcntl(fd, F_SETLKW, &lock) == -1) sys_error("lock '%s'", path);
+
+    char text[64];
+    ssize_t len = pread(fd, text, sizeof text - 1, 0);
+    if(len < 0) sys_error("read '%s'", path);
+    text[len] = '\0';
+
+    unsigned long long h = 0, m = 0;
+    sscanf(text, "%llu %llu", &h, &m);
+    h += hits;
+    m += misses;
+
+    if(hits > 0 || misses > 0) {
+        len = sprintf(text, "%llu %llu\n", h, m);
+        if(pwrite(fd, text, len, 0) != len || ftruncate(fd, len) == -1) sys_error("write '%s'", path);
+    }
+
+    close(fd);
+    free(path);
+    if(total_hits != NULL) *total_hits = h;
+    if(total_misses != NULL) *total_misses = m;
+}
+
+FILE *cache_find(const cache_t *cache, const cache_key_t *key) {
+    if(mkdir(cache->dir, 0755) == -1 && errno != EEXIST) sys_error("mkdir '%s'", cache->dir);
+
+    char *path = entry_path(cache, key);
+    FILE *fp = fopen(path, "rb");
+    free(path);
+
+    // the modification time of an output is when it was last used.
+    if(fp != NULL) futimens(fileno(fp), NULL);
+    count_stats(cache, fp != NULL, fp == NULL, NULL, NULL);
+    return fp;
+}
+
+typedef struct {
+    char *name;
+    off_t size;
+    struct timespec used;
+} entry_t;
+
+static int compare_used(const void *a, const void *b) {
+    const struct timespec *x = &((const entry_t *) a)->used;
+    const struct timespec *y = &((const entry_t *) b)->used;
+    if(x->tv_sec != y->tv_sec) return (x->tv_sec > y->tv_sec) - (x->tv_sec < y->tv_sec);
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+/**
+ * lists the cached outputs, and returns their total size.
+ */
+static uint64_t list_entries(const cache_t *cache, entry_t **entries, unsigned *count) {
+    DIR *dir = opendir(cache->dir);
+    if(dir == NULL) sys_error("opendir '%s'", cache->dir);
+
+    unsigned capacity = 16;
+    *count = 0;
+    *entries = malloc(capacity * sizeof **entries);
+    if(*entries == NULL) sys_error("malloc cache entries");
+
+    uint64_t total = 0;
+    struct dirent *ent;
+    while((ent = readdir(dir)) != NULL) {
+        if(!is_entry(ent->d_name)) continue;
+
+        // another compile may have removed it in the meantime.
+        char *path = cache_path(cache, ent->d_name);
+        struct stat st;
+        int found = stat(path, &st);
+        free(path);
+        if(found == -1) continue;
+
+        if(*count == capacity) {
+            capacity *= 2;
+            *entries = realloc(*entries, capacity * sizeof **entries);
+            if(*entries == NULL) sys_error("realloc cache entries");
+        }
+
+        entry_t *e = &(*entries)[(*count)++];
+        e->name = strdup(ent->d_name);
+        if(e->name == NULL) sys_error("strdup");
+        e->size = st.st_size;
+        e->used = st.st_mtim;
+        total += st.st_size;
+    }
+
+    closedir(dir);
+    return total;
+}
+
+static void free_entries(entry_t *entries, unsigned count) {
+    for(unsigned i = 0; i < count; ++i) free(entries[i].name);
+    free(entries);
+}
+
+/**
+ * removes the least recently used outputs until the rest fit.
+ */
+static void evict(const cache_t *cache) {
+    entry_t *entries;
+    unsigned count;
+    uint64_t total = list_entries(cache, &entries, &count);
+
+    if(total > cache->max_size) {
+        qsort(entries, count, sizeof *entries, compare_used);
+        for(unsigned i = 0; i < count && total > cache->max_size; ++i) {
+            char *path = cache_path(cache, entries[i].name);
+            if(unlink(path) == 0 || errno == ENOENT) total -= entries[i].size;
+            free(path);
+        }
+    }
+
+    free_entries(entries, count);
+}
+
+void cache_store(const cache_t *cache, const cache_key_t *key, const char *outfile) {
+    struct stat st;
+    if(stat(outfile, &st) == -1 || !S_ISREG(st.st_mode)) return;
+    FILE *in = fopen(outfile, "rb");
+    if(in == NULL) sys_error("fopen '%s'", outfile);
+
+    // the output is copied under a name of its own first, so a compile
+    // running at the same time never sees half of it.
+    char tmp_name[64];
+    sprintf(tmp_name, "tmp.%ld", (long) getpid());
+    char *tmp = cache_path(cache, tmp_name);
+    FILE *out = fopen(tmp, "wb");
+    if(out == NULL) sys_error("fopen '%s'", tmp);
+
+    char *buf = malloc(COPY_SIZE);
+    if(buf == NULL) sys_error("malloc copy buffer");
+    size_t n;
+    while((n = fread(buf, 1, COPY_SIZE, in)) > 0) {
+        if(fwrite(buf, 1, n, out) != n) sys_error("write '%s'", tmp);
+    }
+    if(ferror(in)) sys_error("read '%s'", outfile);
+    free(buf);
+    fclose(in);
+    if(fclose(out) != 0) sys_error("fclose '%s'", tmp);
+
+    char *path = entry_path(cache, key);
+    if(rename(tmp, path) == -1) sys_error("rename '%s'", tmp);
+    free(tmp);
+    free(path);
+
+    evict(cache);
+}
+
+void cache_report(const cache_t *cache, FILE *out) {
+    uint64_t hits, misses;
+    count_stats(cache, 0, 0, &hits, &misses);
+
+    entry_t *entries;
+    unsigned count;
+    uint64_t total = list_entries(cache, &entries, &count);
+    free_entries(entries, count);
+
+    fprintf(out, "cache: %llu hits, %llu misses, %u outputs of %llu bytes (at most %llu)\n",
+        (unsigned long long) hits, (unsigned long long) misses, count,
+        (unsigned long long) total, (unsigned long long) cache->max_size);
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "asm.h"
+
+// the most bytes a cache directory holds unless told otherwise.
+#define CACHE_DEFAULT_SIZE (256ul << 20)
+
+/**
+ * A directory of compiled outputs, named by a hash of everything they
+ * were compiled from. The least recently used outputs are removed when
+ * the directory grows past max_size bytes. The hits and misses of every
+ * compile using the directory are counted in a file in it.
+ */
+typedef struct {
+    const char *dir;
+    uint64_t max_size;
+
+    // whether the statistics are written after compiling.
+    bool stats;
+} cache_t;
+
+/**
+ * A 128 bit hash of a source and the options it is compiled with.
+ */
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} cache_key_t;
+
+/**
+ * hashes the instructions of a source file, leaving out the comments,
+ * with the options and version it is compiled with. Sources that differ
+ * only in comments get the same key, unless the output names places in
+ * the source.
+ */
+cache_key_t cache_key(const asm_info_t *info, const char *infile, const char *version, bool assemble, bool executable);
+
+/**
+ * opens the cached output of a key for reading, and counts a hit, or
+ * counts a miss and returns NULL.
+ */
+FILE *cache_find(const cache_t *cache, const cache_key_t *key);
+
+/**
+ * stores a copy of a compiled output under a key, and removes the least
+ * recently used outputs that no longer fit. Outputs that are not regular
+ * files are not stored.
+ */
+void cache_store(const cache_t *cache, const cache_key_t *key, const char *outfile);
+
+/**
+ * writes the hits, misses and size of the cache.
+ */
+void cache_report(const cache_t *cache, FILE *out);
@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "cgen.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "err.h"
+
+#define NL "\n"
+
+// the i/o buffers of the generated program, as in the assembly.
+#define BUFFER_SIZE 65536
+
+static const char *cell_type(asm_info_t *info) {
+    switch (info->cell_size) {
+    case 2: return "uint16_t";
+    case 4: return "uint32_t";
+    case 8: return "uint64_t";
+    default: return "uint8_t";
+    }
+}
+
+/**
+ * Writes the runtime of the program: the tape, and output and input
+ * buffered like the assembly does, which only writes its output when the
+ * buffer is full, the program ends or it waits for more input. The i/o
+ * functions are inline, so a program that does not use them does not warn.
+ */
+static void cgen_header(asm_info_t *info, text_t *out) {
+    text_printf(out,
+    "/* generated by bfc */" NL
+    NL
+    "#define _POSIX_C_SOURCE 200809L" NL
+    NL
+    "#include <stdint.h>" NL
+    "#include <string.h>" NL
+    "#include <unistd.h>" NL
+    NL
+    "#ifndef BF_TAPE_SIZE" NL
+    "#define BF_TAPE_SIZE %d" NL
+    "#endif" NL
+    "#ifndef BF_BUFFER_SIZE" NL
+    "#define BF_BUFFER_SIZE %d" NL
+    "#endif" NL
+    NL
+    "typedef %s cell_t;" NL
+    NL
+    "static cell_t tape[2 * BF_TAPE_SIZE + 1];" NL
+    "static unsigned char obuf[BF_BUFFER_SIZE];" NL
+    "static unsigned char ibuf[BF_BUFFER_SIZE];" NL
+    "static size_t olen, ipos, ilen;" NL
+    NL
+    "static void bf_write(const unsigned char *buf, size_t len) {" NL
+    "    while(len > 0) {" NL
+    "        ssize_t n = write(STDOUT_FILENO, buf, len);" NL
+    "        if(n <= 0) return;" NL
+    "        buf += n;" NL
+    "        len -= n;" NL
+    "    }" NL
+    "}" NL
+    NL
+    "static inline void bf_flush(void) {" NL
+    "    bf_write(obuf, olen);" NL
+    "    olen = 0;" NL
+    "}" NL
+    NL
+    "static inline void bf_put(cell_t c) {" NL
+    "    obuf[olen++] = (unsigned char) c;" NL
+    "    if(olen == BF_BUFFER_SIZE) bf_flush();" NL
+    "}" NL
+    NL
+    "static inline void bf_get(cell_t *c) {" NL
+    "    if(ipos == ilen) {" NL
+    "        bf_flush();" NL
+    "        ssize_t n = read(STDIN_FILENO, ibuf, BF_BUFFER_SIZE);" NL
+    "        if(n <= 0) {" NL
+    , info->stack_size, BUFFER_SIZE, cell_type(info));
+
+    // on end of input (or a failed read) the cell is handled as requested.
+    switch (info->eof_handling) {
+    case ZERO:
+        TEXT_LIT(out, "            *c = 0;" NL);
+        break;
+    case NEGATIVE:
+        TEXT_LIT(out, "            *c = (cell_t) -1;" NL);
+        break;
+    case UNCHANGED:
+        break;
+    }
+
+    TEXT_LIT(out,
+    "            return;" NL
+    "        }" NL
+    "        ipos = 0;" NL
+    "        ilen = n;" NL
+    "    }" NL
+    "    *c = ibuf[ipos++];" NL
+    "}" NL
+    NL
+    "int main(void) {" NL
+    "    cell_t *p = tape + BF_TAPE_SIZE;" NL);
+}
+
+/**
+ * writes numbers as the elements of an array, 16 to a line.
+ */
+static void cgen_numbers(text_t *out, const uint64_t *values, size_t len) {
+    for(size_t i = 0; i < len; ++i) {
+        if(i % 16 == 0) TEXT_LIT(out, NL "        ");
+        else TEXT_LIT(out, " ");
+        text_uint(out, values[i]);
+        TEXT_LIT(out, "u,");
+    }
+    TEXT_LIT(out, NL);
+}
+
+/**
+ * restores the cells and writes the output of an evaluated prefix, and
+ * continues at its resume instruction. The cells are written by value, so
+ * the program does not depend on the byte order of the host.
+ */
+static void cgen_prefix(asm_info_t *info, text_t *out, const prefix_t *prefix) {
+    size_t count = prefix->high - prefix->low;
+    if(count > 0) {
+        int reach = (-prefix->low > prefix->high - 1) ? -prefix->low : prefix->high - 1;
+        text_printf(out,
+        "#if BF_TAPE_SIZE < %d" NL
+        "#error \"the tape does not hold the cells evaluated while compiling\"" NL
+        "#endif" NL
+        , reach);
+
+        uint64_t *values = malloc(count * sizeof *values);
+        if(values == NULL) sys_error("malloc prefix cells");
+
+        for(size_t i = 0; i < count; ++i) {
+            values[i] = 0;
+            for(int b = 0; b < info->cell_size; ++b) {
+                values[i] |= (uint64_t) prefix->cells[i * info->cell_size + b] << (8 * b);
+            }
+        }
+
+        TEXT_LIT(out, "    static const cell_t prefix_tape[] = {");
+        cgen_numbers(out, values, count);
+        text_printf(out,
+        "    };" NL
+        "    memcpy(p + %d, prefix_tape, sizeof prefix_tape);" NL
+        , prefix->low);
+        free(values);
+    }
+
+    if(prefix->output_len > 0) {
+        uint64_t *values = malloc(prefix->output_len * sizeof *values);
+        if(values == NULL) sys_error("malloc prefix output");
+        for(size_t i = 0; i < prefix->output_len; ++i) values[i] = prefix->output[i];
+
+        TEXT_LIT(out, "    static const unsigned char prefix_out[] = {");
+        cgen_numbers(out, values, prefix->output_len);
+        TEXT_LIT(out,
+        "    };" NL
+        "    bf_write(prefix_out, sizeof prefix_out);" NL);
+        free(values);
+    }
+
+    if(prefix->ptr != 0) text_printf(out, "    p += %d;" NL, prefix->ptr);
+    TEXT_LIT(out, "    goto resume;" NL);
+}
+
+static void indent(text_t *out, unsigned depth) {
+    for(unsigned i = 0; i <= depth; ++i) TEXT_LIT(out, "    ");
+}
+
+/**
+ * writes the addition of a constant to a cell. Negative constants are
+ * subtracted, so they are never out of range for the cell.
+ */
+static void cgen_add(text_t *out, int offset, int value) {
+    if(value < 0) text_printf(out, "p[%d] -= %uu;" NL, offset, 0u - (unsigned) value);
+    else text_printf(out, "p[%d] += %uu;" NL, offset, (unsigned) value);
+}
+
+static void cgen_ins(text_t *out, ir_t *ins, unsigned depth) {
+    indent(out, depth);
+
+    switch (ins->op) {
+    case IR_ADD:
+        cgen_add(out, ins->off, ins->val);
+        break;
+    case IR_SET:
+        text_printf(out, "p[%d] = (cell_t) %d;" NL, ins->off, ins->val);
+        break;
+    case IR_MUL_ADD:
+        // the product is taken in 64 bits, as smaller cells would be
+        // promoted to int, which may overflow.
+        if(ins->val == 1) text_printf(out, "p[%d] += p[%d];" NL, ins->off, ins->src);
+        else if(ins->val == -1) text_printf(out, "p[%d] -= p[%d];" NL, ins->off, ins->src);
+        else text_printf(out, "p[%d] += (cell_t) (p[%d] * (uint64_t) (cell_t) %d);" NL, ins->off, ins->src, ins->val);
+        break;
+    case IR_MOVE:
+        if(ins->val < 0) text_printf(out, "p -= %u;" NL, 0u - (unsigned) ins->val);
+        else text_printf(out, "p += %d;" NL, ins->val);
+        break;
+    case IR_SCAN:
+        if(ins->val < 0) text_printf(out, "while(p[0]) p -= %u;" NL, 0u - (unsigned) ins->val);
+        else text_printf(out, "while(p[0]) p += %d;" NL, ins->val);
+        break;
+    case IR_READ:
+        text_printf(out, "bf_get(&p[%d]);" NL, ins->off);
+        break;
+    case IR_WRITE:
+        text_printf(out, "bf_put(p[%d]);" NL, ins->off);
+        break;
+    case IR_LOOP_BEGIN:
+        TEXT_LIT(out, "while(p[0]) {" NL);
+        break;
+    case IR_LOOP_END:
+        TEXT_LIT(out, "}" NL);
+        break;
+    }
+}
+
+void cgen_program(asm_info_t *info, text_t *out, irlist_t *ir, unsigned start, const prefix_t *prefix) {
+    cgen_header(info, out);
+    if(prefix != NULL) cgen_prefix(info, out, prefix);
+
+    // a program evaluated to its end has no use for the data pointer.
+    if(start == ir->count) TEXT_LIT(out, "    (void) p;" NL);
+
+    // the resume label may be inside a loop, which c can jump into.
+    unsigned depth = 0;
+    for(unsigned i = start; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        if(prefix != NULL && i == prefix->resume) TEXT_LIT(out, "resume:;" NL);
+
+        if(ins->op == IR_LOOP_END) depth--;
+        cgen_ins(out, ins, depth);
+        if(ins->op == IR_LOOP_BEGIN) depth++;
+    }
+    if(prefix != NULL && prefix->resume == ir->count) TEXT_LIT(out, "resume:;" NL);
+
+    TEXT_LIT(out,
+    "    bf_flush();" NL
+    "    return 0;" NL
+    "}" NL);
+}
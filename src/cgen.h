@@ -0,0 +1,19 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ir.h"
+#include "asm.h"
+#include "text.h"
+
+/**
+ * writes the ir from start as a C translation unit, for a C compiler to
+ * optimize further or to build on other hosts. The state of an evaluated
+ * prefix is restored first, if there is one, and the program continues at
+ * its resume instruction. The size of the tape and of the i/o buffers can
+ * be changed with -DBF_TAPE_SIZE and -DBF_BUFFER_SIZE.
+ */
+void cgen_program(asm_info_t *info, text_t *out, irlist_t *ir, unsigned start, const prefix_t *prefix);
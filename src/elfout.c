@@ -0,0 +1,417 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "elfout.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#include "err.h"
+
+#define PAGE_SIZE 4096
+
+// the sections of x86_obj_t come first, after the null section.
+#define SHN(section) (1 + (section))
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} buf_t;
+
+static size_t buf_add(buf_t *buf, const void *data, size_t len) {
+    if(buf->size + len > buf->capacity) {
+        buf->capacity = 2 * (buf->size + len) + 256;
+        buf->data = realloc(buf->data, buf->capacity);
+        if(buf->data == NULL) sys_error("realloc elf buffer");
+    }
+
+    size_t at = buf->size;
+    memcpy(buf->data + at, data, len);
+    buf->size += len;
+    return at;
+}
+
+static size_t buf_str(buf_t *buf, const char *str) {
+    return buf_add(buf, str, strlen(str) + 1);
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static const uint64_t section_flags[X86_SECTIONS] = {
+    SHF_ALLOC | SHF_EXECINSTR,
+    SHF_ALLOC,
+    SHF_ALLOC | SHF_WRITE,
+    SHF_ALLOC | SHF_WRITE
+};
+
+typedef struct {
+    buf_t symtab;
+    buf_t strtab;
+    unsigned first_global;
+
+    // the index in .symtab of every symbol, 0 for numeric labels.
+    unsigned *index;
+} symbols_t;
+
+static void add_sym(symbols_t *s, const char *name, unsigned char info, int shndx, uint64_t value) {
+    Elf64_Sym sym = {
+        .st_name = (name != NULL) ? buf_str(&s->strtab, name) : 0,
+        .st_info = info,
+        .st_other = STV_DEFAULT,
+        .st_shndx = shndx,
+        .st_value = value,
+        .st_size = 0
+    };
+    buf_add(&s->symtab, &sym, sizeof sym);
+}
+
+/**
+ * builds the symbol table. ELF wants every local symbol before the global
+ * ones, and numeric labels are left out; relocations against them use the
+ * symbol of their section.
+ */
+static void build_symbols(x86_obj_t *obj, const uint64_t base[X86_SECTIONS], symbols_t *s) {
+    memset(s, 0, sizeof *s);
+    s->index = calloc(obj->sym_count + 1, sizeof *s->index);
+    if(s->index == NULL) sys_error("calloc symbol indices");
+
+    buf_str(&s->strtab, "");
+    add_sym(s, NULL, 0, SHN_UNDEF, 0);
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        add_sym(s, NULL, ELF64_ST_INFO(STB_LOCAL, STT_SECTION), SHN(i), base[i]);
+    }
+
+    unsigned count = 1 + X86_SECTIONS;
+    for(int global = 0; global <= 1; ++global) {
+        if(global) s->first_global = count;
+
+        for(unsigned i = 0; i < obj->sym_count; ++i) {
+            x86_sym_t *sym = &obj->syms[i];
+            if(sym->local_label) continue;
+
+            bool is_global = sym->global || sym->section < 0;
+            if(is_global != global) continue;
+
+            if(sym->section < 0) {
+                add_sym(s, sym->name, ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE), SHN_UNDEF, 0);
+            } else {
+                unsigned char bind = global ? STB_GLOBAL : STB_LOCAL;
+                add_sym(s, sym->name, ELF64_ST_INFO(bind, STT_NOTYPE), SHN(sym->section),
+                    base[sym->section] + sym->offset);
+            }
+            s->index[i] = count++;
+        }
+    }
+}
+
+static void free_symbols(symbols_t *s) {
+    free(s->symtab.data);
+    free(s->strtab.data);
+    free(s->index);
+}
+
+// the output, written front to back so that it may be a pipe.
+typedef struct {
+    FILE *out;
+    uint64_t pos;
+} writer_t;
+
+/**
+ * writes a part at an offset past everything written so far, padding the
+ * gap with zeros.
+ */
+static void write_at(writer_t *w, uint64_t offset, const void *data, size_t len) {
+    static const unsigned char zeros[PAGE_SIZE];
+
+    if(len == 0) return;
+    assert(offset >= w->pos);
+    while(w->pos < offset) {
+        size_t n = (offset - w->pos < sizeof zeros) ? offset - w->pos : sizeof zeros;
+        if(fwrite(zeros, 1, n, w->out) != n) sys_error("write output");
+        w->pos += n;
+    }
+    if(fwrite(data, 1, len, w->out) != len) sys_error("write output");
+    w->pos += len;
+}
+
+static Elf64_Ehdr elf_header(uint16_t type) {
+    Elf64_Ehdr ehdr = {
+        .e_type = type,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr)
+    };
+
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    return ehdr;
+}
+
+/**
+ * the section headers shared by objects and executables: the sections of
+ * the object, the symbol table and its strings. offsets are where their
+ * contents are in the file.
+ */
+static void section_headers(x86_obj_t *obj, buf_t *shdrs, buf_t *shstrtab,
+    const uint64_t base[X86_SECTIONS], const uint64_t offsets[X86_SECTIONS],
+    symbols_t *syms, uint64_t symtab_offset, uint64_t strtab_offset) {
+    Elf64_Shdr null = { 0 };
+    buf_str(shstrtab, "");
+    buf_add(shdrs, &null, sizeof null);
+
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        Elf64_Shdr shdr = {
+            .sh_name = buf_str(shstrtab, x86_section_names[i]),
+            .sh_type = (i == X86_BSS) ? SHT_NOBITS : SHT_PROGBITS,
+            .sh_flags = section_flags[i],
+            .sh_addr = base[i],
+            .sh_offset = offsets[i],
+            .sh_size = obj->sections[i].size,
+            .sh_addralign = obj->sections[i].align
+        };
+        buf_add(shdrs, &shdr, sizeof shdr);
+    }
+
+    unsigned symtab = shdrs->size / sizeof(Elf64_Shdr);
+    Elf64_Shdr shdr = {
+        .sh_name = buf_str(shstrtab, ".symtab"),
+        .sh_type = SHT_SYMTAB,
+        .sh_offset = symtab_offset,
+        .sh_size = syms->symtab.size,
+        .sh_link = symtab + 1,
+        .sh_info = syms->first_global,
+        .sh_addralign = 8,
+        .sh_entsize = sizeof(Elf64_Sym)
+    };
+    buf_add(shdrs, &shdr, sizeof shdr);
+
+    Elf64_Shdr strtab = {
+        .sh_name = buf_str(shstrtab, ".strtab"),
+        .sh_type = SHT_STRTAB,
+        .sh_offset = strtab_offset,
+        .sh_size = syms->strtab.size,
+        .sh_addralign = 1
+    };
+    buf_add(shdrs, &strtab, sizeof strtab);
+}
+
+void elf_write_object(x86_obj_t *obj, FILE *out) {
+    const uint64_t zero[X86_SECTIONS] = { 0 };
+
+    symbols_t syms;
+    build_symbols(obj, zero, &syms);
+
+    // the relocations of every section.
+    static const uint32_t types[] = {
+        [X86_ABS64] = R_X86_64_64,
+        [X86_ABS32] = R_X86_64_32,
+        [X86_ABS32S] = R_X86_64_32S,
+        [X86_PC32] = R_X86_64_PC32
+    };
+
+    buf_t relas[X86_SECTIONS] = { { 0 } };
+    for(unsigned i = 0; i < obj->reloc_count; ++i) {
+        x86_reloc_t *r = &obj->relocs[i];
+        x86_sym_t *sym = &obj->syms[r->sym];
+
+        unsigned index = syms.index[r->sym];
+        int64_t addend = r->addend;
+        if(sym->local_label) {
+            index = 1 + sym->section;
+            addend += sym->offset;
+        }
+
+        Elf64_Rela rela = {
+            .r_offset = r->offset,
+            .r_info = ELF64_R_INFO(index, types[r->type]),
+            .r_addend = addend
+        };
+        buf_add(&relas[r->section], &rela, sizeof rela);
+    }
+
+    // contents follow the header, each aligned as required.
+    uint64_t offsets[X86_SECTIONS];
+    uint64_t pos = sizeof(Elf64_Ehdr);
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        pos = align_up(pos, obj->sections[i].align);
+        offsets[i] = pos;
+        if(i != X86_BSS) pos += obj->sections[i].size;
+    }
+
+    uint64_t symtab_offset = align_up(pos, 8);
+    uint64_t strtab_offset = symtab_offset + syms.symtab.size;
+    pos = strtab_offset + syms.strtab.size;
+
+    uint64_t rela_offsets[X86_SECTIONS];
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        pos = align_up(pos, 8);
+        rela_offsets[i] = pos;
+        pos += relas[i].size;
+    }
+
+    buf_t shdrs = { 0 }, shstrtab = { 0 };
+    section_headers(obj, &shdrs, &shstrtab, zero, offsets, &syms, symtab_offset, strtab_offset);
+
+    unsigned symtab = shdrs.size / sizeof(Elf64_Shdr) - 2;
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        if(relas[i].size == 0) continue;
+
+        char name[32];
+        snprintf(name, sizeof name, ".rela%s", x86_section_names[i]);
+        Elf64_Shdr shdr = {
+            .sh_name = buf_str(&shstrtab, name),
+            .sh_type = SHT_RELA,
+            .sh_flags = SHF_INFO_LINK,
+            .sh_offset = rela_offsets[i],
+            .sh_size = relas[i].size,
+            .sh_link = symtab,
+            .sh_info = SHN(i),
+            .sh_addralign = 8,
+            .sh_entsize = sizeof(Elf64_Rela)
+        };
+        buf_add(&shdrs, &shdr, sizeof shdr);
+    }
+
+    Elf64_Shdr names = {
+        .sh_name = buf_str(&shstrtab, ".shstrtab"),
+        .sh_type = SHT_STRTAB,
+        .sh_offset = pos,
+        .sh_size = shstrtab.size,
+        .sh_addralign = 1
+    };
+    buf_add(&shdrs, &names, sizeof names);
+    pos += shstrtab.size;
+
+    Elf64_Ehdr ehdr = elf_header(ET_REL);
+    ehdr.e_shoff = align_up(pos, 8);
+    ehdr.e_shnum = shdrs.size / sizeof(Elf64_Shdr);
+    ehdr.e_shstrndx = ehdr.e_shnum - 1;
+
+    writer_t w = { out, 0 };
+    write_at(&w, 0, &ehdr, sizeof ehdr);
+    for(int i = 0; i < X86_BSS; ++i) {
+        write_at(&w, offsets[i], obj->sections[i].data, obj->sections[i].size);
+    }
+    write_at(&w, symtab_offset, syms.symtab.data, syms.symtab.size);
+    write_at(&w, strtab_offset, syms.strtab.data, syms.strtab.size);
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        write_at(&w, rela_offsets[i], relas[i].data, relas[i].size);
+        free(relas[i].data);
+    }
+    write_at(&w, names.sh_offset, shstrtab.data, shstrtab.size);
+    write_at(&w, ehdr.e_shoff, shdrs.data, shdrs.size);
+
+    free(shdrs.data);
+    free(shstrtab.data);
+    free_symbols(&syms);
+}
+
+/**
+ * Every section gets pages of its own, so each can be loaded with its own
+ * protection. The file offset and address of a section are kept equal
+ * modulo the page size, as the loader maps it straight from the file.
+ */
+void elf_write_executable(x86_obj_t *obj, FILE *out) {
+    static const uint32_t flags[X86_SECTIONS] = {
+        PF_R | PF_X, PF_R, PF_R | PF_W, PF_R | PF_W
+    };
+
+    uint64_t offsets[X86_SECTIONS];
+    uint64_t base[X86_SECTIONS];
+    uint64_t pos = PAGE_SIZE;
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        pos = align_up(pos, PAGE_SIZE);
+        offsets[i] = pos;
+        base[i] = ELF_BASE + pos;
+        pos += obj->sections[i].size;
+    }
+
+    x86_link(obj, base);
+
+    int entry = x86_find(obj, "_start");
+    if(entry < 0 || obj->syms[entry].section != X86_TEXT) error("ld: no entry point _start");
+
+    // the headers are loaded with the code, and the stack is not executable.
+    Elf64_Phdr phdrs[X86_SECTIONS + 1];
+    unsigned phnum = 0;
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        uint64_t size = obj->sections[i].size;
+        if(size == 0 && i != X86_TEXT) continue;
+
+        uint64_t start = (i == X86_TEXT) ? 0 : offsets[i];
+        Elf64_Phdr phdr = {
+            .p_type = PT_LOAD,
+            .p_flags = flags[i],
+            .p_offset = start,
+            .p_vaddr = ELF_BASE + start,
+            .p_paddr = ELF_BASE + start,
+            .p_filesz = (i == X86_BSS) ? 0 : offsets[i] + size - start,
+            .p_memsz = offsets[i] + size - start,
+            .p_align = PAGE_SIZE
+        };
+        phdrs[phnum++] = phdr;
+    }
+
+    Elf64_Phdr stack = { .p_type = PT_GNU_STACK, .p_flags = PF_R | PF_W, .p_align = 16 };
+    phdrs[phnum++] = stack;
+
+    // .bss takes no space in the file.
+    pos = offsets[X86_BSS];
+
+    symbols_t syms;
+    build_symbols(obj, base, &syms);
+
+    uint64_t symtab_offset = align_up(pos, 8);
+    uint64_t strtab_offset = symtab_offset + syms.symtab.size;
+    pos = strtab_offset + syms.strtab.size;
+
+    buf_t shdrs = { 0 }, shstrtab = { 0 };
+    section_headers(obj, &shdrs, &shstrtab, base, offsets, &syms, symtab_offset, strtab_offset);
+
+    Elf64_Shdr names = {
+        .sh_name = buf_str(&shstrtab, ".shstrtab"),
+        .sh_type = SHT_STRTAB,
+        .sh_offset = pos,
+        .sh_size = shstrtab.size,
+        .sh_addralign = 1
+    };
+    buf_add(&shdrs, &names, sizeof names);
+    pos += shstrtab.size;
+
+    Elf64_Ehdr ehdr = elf_header(ET_EXEC);
+    ehdr.e_entry = base[X86_TEXT] + obj->syms[entry].offset;
+    ehdr.e_phoff = sizeof ehdr;
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = phnum;
+    ehdr.e_shoff = align_up(pos, 8);
+    ehdr.e_shnum = shdrs.size / sizeof(Elf64_Shdr);
+    ehdr.e_shstrndx = ehdr.e_shnum - 1;
+
+    writer_t w = { out, 0 };
+    write_at(&w, 0, &ehdr, sizeof ehdr);
+    write_at(&w, ehdr.e_phoff, phdrs, phnum * sizeof *phdrs);
+    for(int i = 0; i < X86_BSS; ++i) {
+        write_at(&w, offsets[i], obj->sections[i].data, obj->sections[i].size);
+    }
+    write_at(&w, symtab_offset, syms.symtab.data, syms.symtab.size);
+    write_at(&w, strtab_offset, syms.strtab.data, syms.strtab.size);
+    write_at(&w, names.sh_offset, shstrtab.data, shstrtab.size);
+    write_at(&w, ehdr.e_shoff, shdrs.data, shdrs.size);
+
+    free(shdrs.data);
+    free(shstrtab.data);
+    free_symbols(&syms);
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+
+#include "x86.h"
+
+// static executables are linked at the same address as ld's default.
+#define ELF_BASE 0x400000
+
+/**
+ * writes an assembled object as a relocatable ELF64 object, which can be
+ * linked with ld.
+ */
+void elf_write_object(x86_obj_t *obj, FILE *out);
+
+/**
+ * links an assembled object at ELF_BASE and writes it as a static ELF64
+ * executable, starting at _start.
+ */
+void elf_write_executable(x86_obj_t *obj, FILE *out);
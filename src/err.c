@@ -13,11 +13,18 @@
 #include <string.h>
 #include <errno.h>
 
+static const char *context = NULL;
+
+void error_context(const char *name) {
+    context = name;
+}
+
 noreturn void error(char *fmt, ...) {
     va_list lst;
     va_start(lst, fmt);
 
     // fprintf(stderr, RED "ERR: " NORM "\n");
+    if(context != NULL) fprintf(stderr, "%s: ", context);
     vfprintf(stderr, fmt, lst);
     fprintf(stderr, "\n");
 
@@ -26,12 +33,14 @@ noreturn void error(char *fmt, ...) {
 }
 
 noreturn void sys_error(char *fmt, ...) {
+    int err = errno;
     va_list lst;
     va_start(lst, fmt);
 
     // fprintf(stderr, RED "SYSTEM ERR: " NORM "\n");
+    if(context != NULL) fprintf(stderr, "%s: ", context);
     vfprintf(stderr, fmt, lst);
-    fprintf(stderr, ": %s\n", strerror(errno));
+    fprintf(stderr, ": %s\n", strerror(err));
 
     va_end(lst);
     exit(EXIT_FAILURE);
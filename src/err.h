@@ -7,5 +7,11 @@
 
 #include <stdnoreturn.h>
 
+/**
+ * prefixes every following error with the name of the file it is about,
+ * or with nothing for NULL.
+ */
+void error_context(const char *name);
+
 noreturn void error(char *fmt, ...);
 noreturn void sys_error(char *fmt, ...);
\ No newline at end of file
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "eval.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "err.h"
+
+// cells on either side of the start the evaluation may use at most.
+#define EVAL_TAPE_MAX (1 << 20)
+
+// the most output the evaluation writes into the program, which holds it.
+#define EVAL_OUTPUT_MAX (64 << 10)
+
+static void output_add(prefix_t *prefix, size_t *capacity, unsigned char c) {
+    if(prefix->output_len == *capacity) {
+        *capacity = 64 + 2 * *capacity;
+        prefix->output = realloc(prefix->output, *capacity);
+        if(prefix->output == NULL) sys_error("realloc prefix output");
+    }
+
+    prefix->output[prefix->output_len++] = c;
+}
+
+void eval_prefix(irlist_t *ir, asm_info_t *info, prefix_t *prefix) {
+    memset(prefix, 0, sizeof *prefix);
+    if(info->eval_steps == 0) return;
+
+    // the same tape as the generated program, with the pointer in the
+    // middle, but at most as large as is worth evaluating.
+    // Cells are evaluated as 64 bits, and cut to their width when stored.
+    int size = (info->stack_size < EVAL_TAPE_MAX) ? info->stack_size : EVAL_TAPE_MAX;
+    uint64_t *tape = calloc(2 * size, sizeof *tape);
+    if(tape == NULL) sys_error("calloc evaluation tape");
+    uint64_t *mid = tape + size;
+    uint64_t mask = (info->cell_size == 8) ? UINT64_MAX : (UINT64_C(1) << (8 * info->cell_size)) - 1;
+
+    size_t capacity = 0;
+    unsigned long steps = 0;
+    int ptr = 0;
+    int low = 0, high = 0;
+
+    // evaluation stops before any instruction that would leave the tape.
+#define IN_TAPE(o) (ptr + (o) >= -size && ptr + (o) < size)
+#define TOUCH(o) do { \
+        if(ptr + (o) < low) low = ptr + (o); \
+        if(ptr + (o) >= high) high = ptr + (o) + 1; \
+    } while(0)
+
+    unsigned i = 0;
+    while(i < ir->count && steps < info->eval_steps) {
+        ir_t *ins = &ir->items[i];
+        unsigned next = i + 1;
+
+        switch (ins->op) {
+        case IR_ADD:
+            if(!IN_TAPE(ins->off)) goto stop;
+            mid[ptr + ins->off] = (mid[ptr + ins->off] + ins->val) & mask;
+            TOUCH(ins->off);
+            break;
+        case IR_SET:
+            if(!IN_TAPE(ins->off)) goto stop;
+            mid[ptr + ins->off] = (uint64_t) ins->val & mask;
+            TOUCH(ins->off);
+            break;
+        case IR_MUL_ADD:
+            if(!IN_TAPE(ins->off) || !IN_TAPE(ins->src)) goto stop;
+            mid[ptr + ins->off] = (mid[ptr + ins->off] + mid[ptr + ins->src] * ins->val) & mask;
+            TOUCH(ins->off);
+            break;
+        case IR_MOVE:
+            ptr += ins->val;
+            break;
+        case IR_SCAN: {
+            int at = ptr;
+            while(ptr >= -size && ptr < size && mid[ptr] != 0
+                && steps < info->eval_steps) {
+                ptr += ins->val;
+                steps++;
+            }
+
+            // an unfinished scan is redone by the generated code.
+            if(!IN_TAPE(0) || mid[ptr] != 0) {
+                ptr = at;
+                goto stop;
+            }
+        } break;
+        case IR_LOOP_BEGIN:
+            if(!IN_TAPE(0)) goto stop;
+            if(mid[ptr] == 0) next = ins->match + 1;
+            break;
+        case IR_LOOP_END:
+            if(!IN_TAPE(0)) goto stop;
+            if(mid[ptr] != 0) next = ins->match + 1;
+            break;
+        case IR_READ:
+            goto stop;
+        case IR_WRITE:
+            if(!IN_TAPE(ins->off) || prefix->output_len == EVAL_OUTPUT_MAX) goto stop;
+            output_add(prefix, &capacity, mid[ptr + ins->off]);
+            break;
+        }
+
+        steps++;
+        i = next;
+    }
+
+stop:
+#undef IN_TAPE
+#undef TOUCH
+
+    prefix->resume = i;
+    prefix->ptr = ptr;
+    prefix->low = low;
+    prefix->high = high;
+
+    // the image of the cells is little endian, like the tape.
+    if(high > low) {
+        int width = info->cell_size;
+        prefix->cells = malloc((size_t) (high - low) * width);
+        if(prefix->cells == NULL) sys_error("malloc prefix cells");
+        for(int c = low; c < high; ++c) {
+            for(int b = 0; b < width; ++b) {
+                prefix->cells[(c - low) * width + b] = mid[c] >> (8 * b);
+            }
+        }
+    }
+
+    free(tape);
+}
+
+void prefix_free(prefix_t *prefix) {
+    free(prefix->cells);
+    free(prefix->output);
+}
@@ -0,0 +1,18 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ir.h"
+#include "asm.h"
+
+/**
+ * Evaluates the input-independent prefix of the program at compile time.
+ * Evaluation stops before the first read, when the program ends, when
+ * info->eval_steps instructions have been executed, or before a write once
+ * the 64 KiB of output the program may hold have been written.
+ */
+void eval_prefix(irlist_t *ir, asm_info_t *info, prefix_t *prefix);
+void prefix_free(prefix_t *prefix);
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "interp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "ir.h"
+#include "opt.h"
+#include "err.h"
+#include "timer.h"
+
+// computed gotos are a GNU extension, other compilers get a switch.
+#ifdef __GNUC__
+#define THREADED
+#endif
+
+#define OBUF_SIZE 65536
+#define IBUF_SIZE 65536
+
+/**
+ * The bytecode is the optimized ir with loops turned into jumps to known
+ * instructions, and multiplications by one turned into copies.
+ */
+typedef enum {
+    BC_ADD,         // cell[off] += val
+    BC_SET,         // cell[off] = val
+    BC_COPY,        // cell[off] += cell[src]
+    BC_MUL,         // cell[off] += cell[src] * val
+    BC_MOVE,        // ptr += val
+    BC_SCAN,        // while(cell[0]) ptr += val
+    BC_JZ,          // if(!cell[0]) goto val
+    BC_JNZ,         // if(cell[0]) goto val
+    BC_READ,        // cell[0] = getchar()
+    BC_WRITE,       // putchar(cell[off])
+    BC_END
+} bcop_e;
+
+typedef struct {
+    const void *handler;
+    bcop_e op;
+    int off;
+    int src;
+    int val;
+} bc_t;
+
+typedef struct {
+    unsigned char obuf[OBUF_SIZE];
+    size_t olen;
+
+    unsigned char ibuf[IBUF_SIZE];
+    size_t ipos;
+    size_t ilen;
+} io_t;
+
+static void io_flush(io_t *io) {
+    size_t done = 0;
+    while(done < io->olen) {
+        ssize_t n = write(STDOUT_FILENO, io->obuf + done, io->olen - done);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) sys_error("write output");
+        done += n;
+    }
+
+    io->olen = 0;
+}
+
+/**
+ * returns the next byte of input, or EOF at the end of it.
+ */
+static int io_getc(io_t *io) {
+    if(io->ipos == io->ilen) {
+        // the output so far is shown before waiting on input.
+        io_flush(io);
+
+        ssize_t n;
+        do n = read(STDIN_FILENO, io->ibuf, IBUF_SIZE);
+        while(n < 0 && errno == EINTR);
+
+        io->ipos = 0;
+        io->ilen = (n > 0) ? n : 0;
+    }
+
+    if(io->ipos < io->ilen) return io->ibuf[io->ipos++];
+    return EOF;
+}
+
+/**
+ * translates the ir into bytecode, ending with BC_END. margin is set to
+ * the largest offset any instruction reaches from the data pointer.
+ */
+static bc_t *translate(irlist_t *ir, int *margin) {
+    bc_t *code = calloc(ir->count + 1, sizeof *code);
+    if(code == NULL) sys_error("calloc bytecode");
+    *margin = 0;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        bc_t *bc = &code[i];
+        bc->off = ins->off;
+        bc->src = ins->src;
+        bc->val = ins->val;
+
+        switch (ins->op) {
+        case IR_ADD: bc->op = BC_ADD; break;
+        case IR_SET: bc->op = BC_SET; break;
+        case IR_MUL_ADD: bc->op = (ins->val == 1) ? BC_COPY : BC_MUL; break;
+        case IR_MOVE: bc->op = BC_MOVE; break;
+        case IR_SCAN: bc->op = BC_SCAN; break;
+        case IR_READ: bc->op = BC_READ; break;
+        case IR_WRITE: bc->op = BC_WRITE; break;
+        // loops jump past their other end.
+        case IR_LOOP_BEGIN:
+            bc->op = BC_JZ;
+            bc->val = ins->match + 1;
+            break;
+        case IR_LOOP_END:
+            bc->op = BC_JNZ;
+            bc->val = ins->match + 1;
+            break;
+        }
+
+        int reach = abs(ins->off) > abs(ins->src) ? abs(ins->off) : abs(ins->src);
+        if(ins->op != IR_MOVE && ins->op != IR_SCAN && reach > *margin) *margin = reach;
+    }
+
+    code[ir->count].op = BC_END;
+    return code;
+}
+
+/**
+ * The bytes of the tape in [low, high), with margin extra bytes on both
+ * ends, so only moves need to check the pointer.
+ */
+typedef struct {
+    unsigned char *mem;
+    unsigned char *low;
+    unsigned char *high;
+    int margin;
+} tape_t;
+
+/**
+ * handles the data pointer leaving the tape. A growing tape doubles until
+ * it covers the pointer again, which is returned moved along with it.
+ */
+static unsigned char *leave_tape(asm_info_t *info, tape_t *tape, unsigned char *p, io_t *io) {
+    if(info->tape != TAPE_GROW) {
+        io_flush(io);
+        error("data pointer left the tape");
+    }
+
+    ptrdiff_t size = tape->high - tape->low;
+    ptrdiff_t pos = p - tape->low;
+    ptrdiff_t below = 0;
+    ptrdiff_t total = size;
+
+    while(pos + below < 0) {
+        below += total;
+        total += total;
+    }
+    while(pos + below >= total) total += total;
+
+    unsigned char *mem = calloc(total + 2 * tape->margin, 1);
+    if(mem == NULL) sys_error("calloc tape");
+
+    unsigned char *low = mem + tape->margin;
+    memcpy(low + below, tape->low, size);
+    free(tape->mem);
+
+    tape->mem = mem;
+    tape->low = low;
+    tape->high = low + total;
+    return low + below + pos;
+}
+
+#define CELL_T uint8_t
+#define EXECUTE execute8
+#include "interp_exec.h"
+#undef CELL_T
+#undef EXECUTE
+
+#define CELL_T uint16_t
+#define EXECUTE execute16
+#include "interp_exec.h"
+#undef CELL_T
+#undef EXECUTE
+
+#define CELL_T uint32_t
+#define EXECUTE execute32
+#include "interp_exec.h"
+#undef CELL_T
+#undef EXECUTE
+
+#define CELL_T uint64_t
+#define EXECUTE execute64
+#include "interp_exec.h"
+#undef CELL_T
+#undef EXECUTE
+
+/**
+ * runs the bytecode on a tape of 2 * size cells, with the pointer in the
+ * middle.
+ */
+static void execute(asm_info_t *info, bc_t *code, int margin, io_t *io) {
+    size_t cell = info->cell_size;
+    size_t size = info->stack_size * cell;
+
+    tape_t tape = { .margin = margin * cell };
+    tape.mem = calloc(2 * (size + tape.margin), 1);
+    if(tape.mem == NULL) sys_error("calloc tape");
+
+    tape.low = tape.mem + tape.margin;
+    tape.high = tape.low + 2 * size;
+    unsigned char *start = tape.low + size;
+
+    switch (info->cell_size) {
+    case 2: execute16(info, code, &tape, start, io); break;
+    case 4: execute32(info, code, &tape, start, io); break;
+    case 8: execute64(info, code, &tape, start, io); break;
+    default: execute8(info, code, &tape, start, io); break;
+    }
+
+    free(tape.mem);
+}
+
+int interp_run(asm_info_t *info, toklist_t *tokens) {
+    irlist_t ir = IRLIST_INIT;
+    ir_lower(&ir, tokens);
+    timer_mark("lower");
+    optimize(&ir, info);
+    timer_mark("optimize");
+
+    int margin;
+    bc_t *code = translate(&ir, &margin);
+    ir_free(&ir);
+    timer_mark("translate");
+    timer_report(stderr);
+
+    io_t *io = calloc(1, sizeof *io);
+    if(io == NULL) sys_error("calloc io buffers");
+
+    execute(info, code, margin, io);
+    io_flush(io);
+
+    free(io);
+    free(code);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "token.h"
+#include "asm.h"
+
+/**
+ * runs the optimized program in an interpreter, reading stdin and writing
+ * stdout, with the same tape and end of input behaviour as the generated
+ * code. Returns the exit status.
+ */
+int interp_run(asm_info_t *info, toklist_t *tokens);
@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+// The interpreter loop for one width of cells. interp.c includes this once
+// per width, with CELL_T as the type of a cell and EXECUTE as the name of
+// the function.
+
+/**
+ * runs the bytecode on the tape, with the pointer starting at start.
+ */
+static void EXECUTE(asm_info_t *info, bc_t *code, tape_t *tape, unsigned char *start, io_t *io) {
+    CELL_T *p = (CELL_T *) start;
+    bc_t *pc = code;
+    int c;
+
+#define CHECK_PTR() do { \
+        if(p < (CELL_T *) tape->low || p >= (CELL_T *) tape->high) { \
+            p = (CELL_T *) leave_tape(info, tape, (unsigned char *) p, io); \
+        } \
+    } while(0)
+
+#ifdef THREADED
+    static const void *handlers[] = {
+        [BC_ADD] = &&op_add, [BC_SET] = &&op_set, [BC_COPY] = &&op_copy,
+        [BC_MUL] = &&op_mul, [BC_MOVE] = &&op_move, [BC_SCAN] = &&op_scan,
+        [BC_JZ] = &&op_jz, [BC_JNZ] = &&op_jnz, [BC_READ] = &&op_read,
+        [BC_WRITE] = &&op_write, [BC_END] = &&op_end
+    };
+    for(bc_t *bc = code;; ++bc) {
+        bc->handler = handlers[bc->op];
+        if(bc->op == BC_END) break;
+    }
+
+#define CASE(op, label) label:
+#define NEXT() goto *pc->handler
+    NEXT();
+#else
+#define CASE(op, label) case op:
+#define NEXT() continue
+    for(;;) switch (pc->op) {
+#endif
+
+    CASE(BC_ADD, op_add)
+        p[pc->off] += (CELL_T) pc->val;
+        pc++;
+        NEXT();
+    CASE(BC_SET, op_set)
+        p[pc->off] = (CELL_T) pc->val;
+        pc++;
+        NEXT();
+    CASE(BC_COPY, op_copy)
+        p[pc->off] += p[pc->src];
+        pc++;
+        NEXT();
+    CASE(BC_MUL, op_mul)
+        // narrow cells are promoted to int, where the product may overflow.
+        p[pc->off] += (CELL_T) ((uint64_t) p[pc->src] * (uint64_t) pc->val);
+        pc++;
+        NEXT();
+    CASE(BC_MOVE, op_move)
+        p += pc->val;
+        CHECK_PTR();
+        pc++;
+        NEXT();
+    CASE(BC_SCAN, op_scan)
+        while(*p != 0) {
+            p += pc->val;
+            CHECK_PTR();
+        }
+        pc++;
+        NEXT();
+    CASE(BC_JZ, op_jz)
+        pc = (*p == 0) ? code + pc->val : pc + 1;
+        NEXT();
+    CASE(BC_JNZ, op_jnz)
+        pc = (*p != 0) ? code + pc->val : pc + 1;
+        NEXT();
+    CASE(BC_READ, op_read)
+        c = io_getc(io);
+        if(c != EOF) *p = c;
+        else if(info->eof_handling == ZERO) *p = 0;
+        else if(info->eof_handling == NEGATIVE) *p = (CELL_T) -1;
+        pc++;
+        NEXT();
+    CASE(BC_WRITE, op_write)
+        io->obuf[io->olen++] = (unsigned char) p[pc->off];
+        if(io->olen == OBUF_SIZE) io_flush(io);
+        pc++;
+        NEXT();
+    CASE(BC_END, op_end)
+        goto done;
+
+#ifndef THREADED
+    }
+#endif
+
+done:
+#undef CASE
+#undef NEXT
+#undef CHECK_PTR
+    return;
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ir.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "err.h"
+
+void ir_lower(irlist_t *ir, toklist_t *tokens) {
+    // the open branches, by token index, innermost last.
+    unsigned depth = 0;
+    unsigned *open = malloc((tokens->count + 1) * sizeof *open);
+    if(open == NULL) sys_error("malloc branch stack");
+
+    for(unsigned i = 0; i <= tokens->count; ++i) {
+        while(depth > 0 && tokens->items[open[depth - 1]].end == i) {
+            ir_add(ir, IR_LOOP_END)->label = tokens->items[open[--depth]].i;
+        }
+        if(i == tokens->count) break;
+
+        tok_t *tok = &tokens->items[i];
+        switch (tok->type) {
+        case MOV:
+            ir_add(ir, IR_MOVE)->val = tok->i;
+            break;
+        case MOD:
+            ir_add(ir, IR_ADD)->val = tok->i;
+            break;
+        case READ:
+            ir_add(ir, IR_READ);
+            break;
+        case WRITE:
+            ir_add(ir, IR_WRITE);
+            break;
+        case BRANCH:
+            ir_add(ir, IR_LOOP_BEGIN)->label = tok->i;
+            open[depth++] = i;
+            break;
+        }
+    }
+
+    free(open);
+    ir_link(ir);
+}
+
+ir_t *ir_add(irlist_t *ir, irop_e op) {
+    ir_t ins = { .op = op };
+    return ir_add_ins(ir, &ins);
+}
+
+ir_t *ir_add_ins(irlist_t *ir, const ir_t *ins) {
+    ir->count++;
+
+    if(ir->count > ir->capacity) {
+        ir->capacity = 32 + 2 * ir->count;
+        ir->items = realloc(ir->items, ir->capacity * sizeof *ir->items);
+        if(ir->items == NULL) sys_error("realloc ir items");
+    }
+
+    ir->items[ir->count - 1] = *ins;
+    return &ir->items[ir->count - 1];
+}
+
+void ir_link(irlist_t *ir) {
+    unsigned depth = 0;
+    unsigned *stack = malloc((ir->count + 1) * sizeof *stack);
+    if(stack == NULL) sys_error("malloc loop stack");
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        if(ir->items[i].op == IR_LOOP_BEGIN) {
+            stack[depth++] = i;
+        } else if(ir->items[i].op == IR_LOOP_END) {
+            assert(depth > 0);
+
+            unsigned begin = stack[--depth];
+            ir->items[begin].match = i;
+            ir->items[i].match = begin;
+        }
+    }
+
+    assert(depth == 0);
+    free(stack);
+}
+
+void ir_free(irlist_t *ir) {
+    free(ir->items);
+    ir->items = NULL;
+    ir->count = ir->capacity = 0;
+}
+
+void ir_print(irlist_t *ir, FILE *out) {
+    unsigned depth = 0;
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        if(ins->op == IR_LOOP_END) depth -= 2;
+
+        fprintf(out, "%*s", depth, "");
+        switch (ins->op) {
+        case IR_ADD: fprintf(out, "ADD [%d] %d\n", ins->off, ins->val); break;
+        case IR_SET: fprintf(out, "SET [%d] %d\n", ins->off, ins->val); break;
+        case IR_MUL_ADD:
+            fprintf(out, "MUL_ADD [%d] [%d]*%d\n", ins->off, ins->src, ins->val);
+            break;
+        case IR_MOVE: fprintf(out, "MOVE %d\n", ins->val); break;
+        case IR_SCAN: fprintf(out, "SCAN %d\n", ins->val); break;
+        case IR_LOOP_BEGIN: fprintf(out, "LOOP_BEGIN %u\n", ins->label); break;
+        case IR_LOOP_END: fprintf(out, "LOOP_END %u\n", ins->label); break;
+        case IR_READ: fprintf(out, "READ [%d]\n", ins->off); break;
+        case IR_WRITE: fprintf(out, "WRITE [%d]\n", ins->off); break;
+        }
+
+        if(ins->op == IR_LOOP_BEGIN) depth += 2;
+    }
+}
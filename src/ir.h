@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+
+#include "token.h"
+
+/**
+ * The intermediate representation is a flat list of instructions. Cells are
+ * addressed relative to the data pointer with an offset, so straight-line
+ * code does not need to move the pointer.
+ */
+typedef enum {
+    IR_ADD,         // cell[off] += val
+    IR_SET,         // cell[off] = val
+    IR_MUL_ADD,     // cell[off] += cell[src] * val
+    IR_MOVE,        // ptr += val
+    IR_SCAN,        // while(cell[0]) ptr += val
+    IR_LOOP_BEGIN,  // while(cell[0]) {
+    IR_LOOP_END,    // }
+    IR_READ,        // cell[off] = getchar()
+    IR_WRITE        // putchar(cell[off])
+} irop_e;
+
+typedef struct {
+    irop_e op;
+    int off;
+    int val;
+    int src;
+
+    // loops refer to the index of their other end, and are numbered for
+    // labels. A scan keeps the label of the loop it replaced.
+    unsigned match;
+    unsigned label;
+} ir_t;
+
+typedef struct {
+    unsigned capacity;
+    unsigned count;
+    ir_t *items;
+} irlist_t;
+
+#define IRLIST_INIT { .capacity = 0, .count = 0, .items = NULL }
+
+/**
+ * lowers the tokens into the list.
+ */
+void ir_lower(irlist_t *ir, toklist_t *tokens);
+
+ir_t *ir_add(irlist_t *ir, irop_e op);
+ir_t *ir_add_ins(irlist_t *ir, const ir_t *ins);
+
+/**
+ * recomputes the match of every loop instruction.
+ */
+void ir_link(irlist_t *ir);
+void ir_free(irlist_t *ir);
+
+void ir_print(irlist_t *ir, FILE *out);
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _GNU_SOURCE
+
+#include "jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "err.h"
+#include "timer.h"
+
+/**
+ * The generated code addresses its symbols with 32 bit absolute operands,
+ * like a static executable linked at a low address. The sections are
+ * therefore placed in the low 2GB of the address space, one after another
+ * on page boundaries so each can get its own protection.
+ */
+noreturn void jit_run(x86_obj_t *obj) {
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t offsets[X86_SECTIONS];
+    uint64_t total = 0;
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        offsets[i] = total;
+        total += (obj->sections[i].size + page - 1) / page * page;
+    }
+
+    unsigned char *mem = mmap(NULL, total, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if(mem == MAP_FAILED) sys_error("mmap program");
+
+    uint64_t base[X86_SECTIONS];
+    for(int i = 0; i < X86_SECTIONS; ++i) base[i] = (uint64_t) (mem + offsets[i]);
+
+    x86_link(obj, base);
+
+    // .bss is left as the zeroed pages of the mapping.
+    for(int i = 0; i < X86_SECTIONS; ++i) {
+        if(obj->sections[i].data != NULL) memcpy(mem + offsets[i], obj->sections[i].data, obj->sections[i].size);
+    }
+
+    size_t text_size = offsets[X86_RODATA] - offsets[X86_TEXT];
+    size_t rodata_size = offsets[X86_DATA] - offsets[X86_RODATA];
+    if(text_size > 0 && mprotect(mem + offsets[X86_TEXT], text_size, PROT_READ | PROT_EXEC) != 0) {
+        sys_error("mprotect text");
+    }
+    if(rodata_size > 0 && mprotect(mem + offsets[X86_RODATA], rodata_size, PROT_READ) != 0) {
+        sys_error("mprotect rodata");
+    }
+
+    int entry = x86_find(obj, "_start");
+    if(entry < 0 || obj->syms[entry].section != X86_TEXT) error("no entry point _start");
+    void (*start)(void) = (void (*)(void)) (base[X86_TEXT] + obj->syms[entry].offset);
+    x86_free(obj);
+    timer_mark("link");
+    timer_report(stderr);
+
+    // the program exits through a syscall, and never returns here.
+    fflush(NULL);
+    start();
+    abort();
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdnoreturn.h>
+
+#include "x86.h"
+
+/**
+ * runs an assembled program in this process, without an external linker,
+ * and frees the object. The program exits the process when done.
+ */
+noreturn void jit_run(x86_obj_t *obj);
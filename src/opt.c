@@ -0,0 +1,487 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "opt.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "err.h"
+
+bool pass_unreachable(irlist_t *ir, asm_info_t *info);
+bool pass_empty(irlist_t *ir, asm_info_t *info);
+bool pass_linear(irlist_t *ir, asm_info_t *info);
+bool pass_scan(irlist_t *ir, asm_info_t *info);
+bool pass_fold_moves(irlist_t *ir, asm_info_t *info);
+bool pass_peephole(irlist_t *ir, asm_info_t *info);
+
+bool(*passes[])(irlist_t *, asm_info_t *) = {
+    pass_unreachable,
+    pass_empty,
+    pass_linear,
+    pass_scan,
+    pass_fold_moves,
+    pass_peephole
+};
+
+// how many instructions back the peephole pass looks for an earlier store
+// to the same cell.
+#define PEEP_WINDOW 32
+
+// passes may enable each other, but should settle long before this.
+#define MAX_ROUNDS 16
+
+void optimize(irlist_t *ir, asm_info_t *info) {
+    if(!info->optimize) return;
+
+    for(unsigned round = 0; round < MAX_ROUNDS; ++round) {
+        bool changed = false;
+        for(unsigned j = 0; j < sizeof passes / sizeof passes[0]; ++j) {
+            if((*passes[j])(ir, info)) changed = true;
+        }
+
+        if(!changed) break;
+    }
+}
+
+/**
+ * replaces the instructions of a list with the result of a pass.
+ */
+static void ir_replace(irlist_t *ir, irlist_t *res) {
+    ir_free(ir);
+    *ir = *res;
+    ir_link(ir);
+}
+
+/**
+ * A loop is unreachable when the current cell is known to be zero, which is
+ * the case at the start of the program and directly after another loop.
+ * A part of a program compiled after others does not start on a blank tape.
+ *
+ * [+++>-<][] second parenthesis can be removed.
+ */
+bool pass_unreachable(irlist_t *ir, asm_info_t *info) {
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    // whether the current cell, and every cell of the tape, is known zero.
+    bool zero = !info->preceded;
+    bool blank = !info->preceded;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        if(ins->op == IR_LOOP_BEGIN && zero) {
+            i = ins->match;
+            changed = true;
+            continue;
+        }
+
+        ir_add_ins(&res, ins);
+
+        switch (ins->op) {
+        case IR_ADD:
+        case IR_SET:
+        case IR_MUL_ADD:
+        case IR_READ:
+            if(ins->off == 0) zero = (ins->op == IR_SET && ins->val == 0);
+            blank = false;
+            break;
+        case IR_MOVE:
+            zero = blank;
+            break;
+        case IR_SCAN:
+        case IR_LOOP_END:
+            zero = true;
+            break;
+        case IR_LOOP_BEGIN:
+            zero = blank = false;
+            break;
+        case IR_WRITE:
+            break;
+        }
+    }
+
+    ir_replace(ir, &res);
+    return changed;
+}
+
+/**
+ * [] should be removed
+ */
+bool pass_empty(irlist_t *ir, asm_info_t *info) {
+    (void) info;
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        if(ins->op == IR_LOOP_BEGIN && ins->match == i + 1) {
+            i = ins->match;
+            changed = true;
+            continue;
+        }
+
+        ir_add_ins(&res, ins);
+    }
+
+    ir_replace(ir, &res);
+    return changed;
+}
+
+/**
+ * returns the multiplicative inverse of an odd value modulo 2^64, which
+ * also is the inverse modulo every smaller power of two.
+ */
+static uint64_t inverse_mod2(uint64_t value) {
+    assert(value % 2 == 1);
+
+    // each newton iteration doubles the number of correct low bits.
+    uint64_t inv = value;
+    for(int i = 0; i < 5; ++i) inv *= 2 - value * inv;
+
+    return inv;
+}
+
+/**
+ * cuts a value to the width of a cell, sign extended back to 64 bits.
+ */
+static uint64_t cell_value(uint64_t value, asm_info_t *info) {
+    if(info->cell_size == 8) return value;
+
+    uint64_t sign = UINT64_C(1) << (8 * info->cell_size - 1);
+    value &= 2 * sign - 1;
+    return (value ^ sign) - sign;
+}
+
+/**
+ * lowers the loop starting at begin into multiplications, if it is
+ * balanced. Returns false and leaves res untouched otherwise.
+ */
+static bool lower_linear(irlist_t *ir, unsigned begin, irlist_t *res, asm_info_t *info) {
+    unsigned end = ir->items[begin].match;
+    unsigned len = end - begin - 1;
+    if(len == 0) return false;
+
+    // the net change of every visited cell, in the order they are visited.
+    int *offsets = malloc(len * sizeof *offsets);
+    uint64_t *deltas = malloc(len * sizeof *deltas);
+    if(offsets == NULL || deltas == NULL) sys_error("malloc linear loop");
+    unsigned cells = 0;
+
+    int pos = 0;
+    uint64_t control = 0;
+    bool linear = true;
+    for(unsigned i = begin + 1; i < end && linear; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        if(ins->op == IR_MOVE) {
+            pos += ins->val;
+        } else if(ins->op == IR_ADD) {
+            int cell = pos + ins->off;
+            if(cell == 0) {
+                control += ins->val;
+                continue;
+            }
+
+            unsigned j = 0;
+            while(j < cells && offsets[j] != cell) ++j;
+            if(j == cells) {
+                offsets[cells] = cell;
+                deltas[cells++] = 0;
+            }
+            deltas[j] += ins->val;
+        } else linear = false;
+    }
+
+    // the factors are taken modulo the cell width, as signed values.
+    linear = linear && pos == 0 && control % 2 == 1;
+    uint64_t scale = linear ? -inverse_mod2(control) : 0;
+    for(unsigned i = 0; i < cells && linear; ++i) {
+        deltas[i] = cell_value(deltas[i] * scale, info);
+        if((int64_t) deltas[i] < INT32_MIN || (int64_t) deltas[i] > INT32_MAX) linear = false;
+    }
+
+    if(linear) {
+        for(unsigned i = 0; i < cells; ++i) {
+            int64_t factor = (int64_t) deltas[i];
+            if(factor == 0) continue;
+
+            ir_t mul = {
+                .op = IR_MUL_ADD,
+                .off = offsets[i],
+                .src = 0,
+                .val = (int) factor
+            };
+            ir_add_ins(res, &mul);
+        }
+
+        ir_t clear = { .op = IR_SET, .off = 0, .val = 0 };
+        ir_add_ins(res, &clear);
+    }
+
+    free(offsets);
+    free(deltas);
+    return linear;
+}
+
+/**
+ * A balanced loop, only moving and modifying cells and returning to the
+ * control cell, adds a multiple of the control cell to each cell it
+ * touches and then leaves the control cell at zero.
+ *
+ * If the control cell changes by c each iteration, the loop runs
+ * n = -cell * c^-1 (mod 2^w) times for w bit cells, which only is known if
+ * c is odd. A cell changed by d each iteration then gets
+ * n * d = cell * (-d * c^-1) added. Wide cells keep the loop when a factor
+ * does not fit an immediate.
+ *
+ * synonyms:
+ * [-]
+ * [->+<]
+ * [>+>++<<-]
+ * [->+<>>-<<]
+ * [--->+<]
+ */
+bool pass_linear(irlist_t *ir, asm_info_t *info) {
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        if(ins->op == IR_LOOP_BEGIN && lower_linear(ir, i, &res, info)) {
+            i = ins->match;
+            changed = true;
+            continue;
+        }
+
+        ir_add_ins(&res, ins);
+    }
+
+    ir_replace(ir, &res);
+    return changed;
+}
+
+/**
+ * [>] moves to the next zero cell, optionally with a stride or backwards.
+ *
+ * synonyms:
+ * [>>>]
+ * [<]
+ */
+bool pass_scan(irlist_t *ir, asm_info_t *info) {
+    (void) info;
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        if(ins->op == IR_LOOP_BEGIN && ins->match == i + 2
+            && ir->items[i + 1].op == IR_MOVE) {
+            ir_t scan = { .op = IR_SCAN, .val = ir->items[i + 1].val, .label = ins->label };
+            ir_add_ins(&res, &scan);
+
+            i = ins->match;
+            changed = true;
+            continue;
+        }
+
+        ir_add_ins(&res, ins);
+    }
+
+    ir_replace(ir, &res);
+    return changed;
+}
+
+/**
+ * adds the movement not yet applied as a single move, and returns whether
+ * that changes the moves it is made up of.
+ */
+static bool apply_moves(irlist_t *res, int pending, unsigned moves) {
+    if(pending != 0) {
+        ir_t move = { .op = IR_MOVE, .val = pending };
+        ir_add_ins(res, &move);
+    }
+
+    return moves > 1 || (moves == 1 && pending == 0);
+}
+
+/**
+ * Straight-line code addresses cells relative to the data pointer, so moves
+ * are folded into the offsets of the following instructions. The pointer is
+ * only moved where it is needed itself: at loops, scans and reads.
+ *
+ * >+>>-<<<+ becomes three adds and no move.
+ */
+bool pass_fold_moves(irlist_t *ir, asm_info_t *info) {
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    // movement not yet applied, and the number of moves it is made up of.
+    int pending = 0;
+    unsigned moves = 0;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t ins = ir->items[i];
+
+        switch (ins.op) {
+        case IR_MOVE:
+            pending += ins.val;
+            moves++;
+            continue;
+        case IR_MUL_ADD:
+            ins.src += pending;
+            // fallthrough
+        case IR_ADD:
+        case IR_SET:
+        case IR_WRITE:
+            ins.off += pending;
+            if(pending != 0) changed = true;
+            break;
+        case IR_READ:
+        case IR_SCAN:
+        case IR_LOOP_BEGIN:
+        case IR_LOOP_END:
+            if(apply_moves(&res, pending, moves)) changed = true;
+            pending = 0;
+            moves = 0;
+            break;
+        }
+
+        ir_add_ins(&res, &ins);
+    }
+
+    // nothing observes the pointer after the last instruction, unless
+    // another part of the program follows.
+    if(info->followed) {
+        if(apply_moves(&res, pending, moves)) changed = true;
+    } else if(moves > 0) {
+        changed = true;
+    }
+
+    ir_replace(ir, &res);
+    return changed;
+}
+
+/**
+ * returns the last instruction in res since run, and within the window,
+ * that stores to the cell at off with nothing reading it since, or NULL.
+ */
+static ir_t *last_store(irlist_t *res, unsigned run, int off) {
+    unsigned stop = (res->count - run > PEEP_WINDOW) ? res->count - PEEP_WINDOW : run;
+
+    for(unsigned i = res->count; i-- > stop;) {
+        ir_t *ins = &res->items[i];
+        switch (ins->op) {
+        case IR_MUL_ADD:
+            if(ins->src == off) return NULL;
+            // fallthrough
+        case IR_ADD:
+        case IR_SET:
+            if(ins->off == off) return ins;
+            break;
+        case IR_WRITE:
+            if(ins->off == off) return NULL;
+            break;
+        default:
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * folds an add or set into an earlier store to the same cell. Returns
+ * false if they can not be combined, when the add would have to be folded
+ * into a multiplication or its sum does not fit an instruction.
+ */
+static bool fold_store(ir_t *store, const ir_t *ins, asm_info_t *info) {
+    if(ins->op == IR_SET) {
+        *store = (ir_t) { .op = IR_SET, .off = store->off, .val = ins->val };
+        return true;
+    }
+
+    if(store->op == IR_MUL_ADD) return false;
+
+    int64_t sum = (int64_t) cell_value((uint64_t) store->val + (uint64_t) ins->val, info);
+    if(sum < INT32_MIN || sum > INT32_MAX) return false;
+
+    store->val = (int) sum;
+    return true;
+}
+
+/**
+ * Instructions storing to a cell that nothing reads before the next store
+ * to it are folded together within straight-line code: adds are summed up,
+ * an add changes the set before it, and a set replaces whatever came
+ * before. A read overwrites the cell too, unless end of input leaves it as
+ * is. Adds that sum up to nothing are dropped.
+ *
+ * +++[-] sets 0
+ * [-]+++++ sets 5
+ * [-]>[-]<[-] sets two cells
+ * >+<>-< does nothing
+ */
+bool pass_peephole(irlist_t *ir, asm_info_t *info) {
+    irlist_t res = IRLIST_INIT;
+    bool changed = false;
+
+    // where the current run of straight-line code starts in res.
+    unsigned run = 0;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        ir_t *store;
+
+        switch (ins->op) {
+        case IR_ADD:
+        case IR_SET:
+            store = last_store(&res, run, ins->off);
+            if(store != NULL && fold_store(store, ins, info)) {
+                changed = true;
+                continue;
+            }
+            break;
+        case IR_READ:
+            store = last_store(&res, run, ins->off);
+            if(store != NULL && info->eof_handling != UNCHANGED) {
+                *store = (ir_t) { .op = IR_ADD, .off = store->off, .val = 0 };
+            }
+            run = res.count + 1;
+            break;
+        case IR_MUL_ADD:
+        case IR_WRITE:
+            break;
+        default:
+            run = res.count + 1;
+            break;
+        }
+
+        ir_add_ins(&res, ins);
+    }
+
+    // drops the adds that do nothing, including the stores made dead.
+    unsigned count = 0;
+    for(unsigned i = 0; i < res.count; ++i) {
+        ir_t *ins = &res.items[i];
+        if(ins->op == IR_ADD && cell_value(ins->val, info) == 0) {
+            changed = true;
+            continue;
+        }
+        res.items[count++] = *ins;
+    }
+    res.count = count;
+
+    ir_replace(ir, &res);
+    return changed;
+}
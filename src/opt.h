@@ -0,0 +1,15 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ir.h"
+#include "asm.h"
+
+/**
+ * runs the optimization passes over the ir, in order, until none of them
+ * change it anymore. Nothing is done if info->optimize is off.
+ */
+void optimize(irlist_t *ir, asm_info_t *info);
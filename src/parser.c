@@ -1,250 +1,998 @@
 /**
  * Copyright (c) 2021 Olle Lögdahl
- * 
+ *
  * This software is released under the MIT License.
  * https://opensource.org/licenses/MIT
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "parser.h"
 
 #include <stdbool.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
 
+#include "ir.h"
+#include "opt.h"
+#include "eval.h"
 #include "err.h"
+#include "timer.h"
+#include "cgen.h"
+
+#define ASM_INFO(ai, as, ...) if(ai->debug) asm_comment(as, __VA_ARGS__)
 
-bool optimize_assign(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out);
-bool optimize_empty(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out);
-bool optimize_unreachable(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out);
-bool optimize_copy_to(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out);
-bool optimize_multiply_to(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out);
-
-bool(*optimizers[])(toklist_t *, unsigned *, asm_info_t *, FILE *) = {
-    optimize_assign,
-    optimize_empty,
-    optimize_unreachable,
-    optimize_copy_to,
-    optimize_multiply_to
-};
-
-#define ASM_INFO(ai, out, ...) if(ai->debug) asm_comment(ai, out, __VA_ARGS__)
-
-void parse_branch(asm_info_t *asm_info, toklist_t *tokens, FILE *out, unsigned offset) {
-    assert(tokens->count > 0);
-
-    for(unsigned i = offset; i < tokens->count; ++i) {
-        // run all optimizers
-        for(unsigned j = 0; j < sizeof optimizers / sizeof optimizers[0]; ++j) {
-            if((*optimizers[j])(tokens, &i, asm_info, out)) continue;
+/**
+ * returns whether an instruction ends a run of straight-line code.
+ */
+static bool ends_run(ir_t *ins) {
+    switch (ins->op) {
+    case IR_ADD:
+    case IR_SET:
+    case IR_MUL_ADD:
+    case IR_WRITE:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static void count_use(cell_use_t *cells, unsigned *len, int offset) {
+    for(unsigned i = 0; i < *len; ++i) {
+        if(cells[i].offset == offset) {
+            cells[i].uses++;
+            return;
         }
+    }
 
-        tok_t *tok = tokens->items[i];
-        switch (tok->type) {
-        case MOV:
-            ASM_INFO(asm_info, out, "mov %d", tok->i);
-            asm_move(asm_info, out, tok->i);
-            break;
-        case MOD:
-            ASM_INFO(asm_info, out, "inc/dec %d", tok->i);
-            asm_diff(asm_info, out, tok->i);
-            break;
-        case READ:
-            ASM_INFO(asm_info, out, "read");
-            asm_read(asm_info, out);
-            break;
-        case WRITE:
-            ASM_INFO(asm_info, out, "write");
-            asm_write(asm_info, out);
-            break;
-        case BRANCH:
-            ASM_INFO(asm_info, out, "branch %s begin", tok->n);
-            asm_branch_begin(asm_info, out, tok->n);
-            parse_branch(asm_info, tok->children, out, 0);
-            ASM_INFO(asm_info, out, "branch %s end", tok->n);
-            asm_branch_end(asm_info, out, tok->n);
-
-            free(tok->n);
+    cells[(*len)++] = (cell_use_t) { .offset = offset, .uses = 1 };
+}
+
+/**
+ * counts the uses of every cell in the straight-line code from start up to
+ * stop, including the test of a loop right after it, and tells the emitter
+ * which cells are used more than once. Only those are worth a register,
+ * which a single use would just add a load and a store to.
+ */
+static void plan_cache(asm_info_t *asm_info, irlist_t *ir, x86_as_t *as, unsigned start, unsigned stop) {
+    // a run uses at most two cells per instruction, and the loop test.
+    cell_use_t cells[2 * CACHE_RUN + 1];
+    unsigned len = 0;
+
+    // longer runs are split, so the registers go to the cells used close
+    // together.
+    if(stop > start + CACHE_RUN) stop = start + CACHE_RUN;
+
+    for(unsigned i = start; i < stop; ++i) {
+        ir_t *ins = &ir->items[i];
+        if(ends_run(ins)) {
+            if(ins->op == IR_LOOP_BEGIN || ins->op == IR_LOOP_END) count_use(cells, &len, 0);
             break;
         }
+
+        if(ins->op == IR_MUL_ADD) count_use(cells, &len, ins->src);
+        count_use(cells, &len, ins->off);
+    }
+
+    unsigned count = 0;
+    for(unsigned i = 0; i < len; ++i) {
+        if(cells[i].uses > 1) cells[count++] = cells[i];
     }
+
+    asm_cache_plan(asm_info, as, cells, count);
 }
 
-void parse(asm_info_t *asm_info, toklist_t *tokens, FILE *out) {
-    if(tokens->count == 0) error("no tokens to parse. aborting.");
+// the longest loop body that is unrolled, in instructions, and the fewest
+// iterations a loop has to run on average each time it is entered.
+#define UNROLL_BODY 16
+#define UNROLL_TRIPS 4
+
+// the fewest iterations a loop has to run on average for its head to be
+// aligned, which pads the code in front of it.
+#define ALIGN_TRIPS 16
 
-    asm_comment(asm_info, out, "generated by bfc");
+/**
+ * The state of emitting the ir as assembly.
+ */
+typedef struct {
+    asm_info_t *info;
+    irlist_t *ir;
+    x86_as_t *as;
+    const prefix_t *prefix;
+
+    // whether the code in each enclosing loop is hot, innermost last.
+    bool *hot;
+    unsigned depth;
+
+    // the loops whose bodies are laid out after the program, by the index
+    // of their beginning.
+    unsigned *outlined;
+    unsigned outlined_count;
+} emit_t;
 
-    ASM_INFO(asm_info, out, "header");
-    asm_header(asm_info, out);
+/**
+ * returns whether the resume label of the prefix is inside a loop. Such a
+ * loop has to stay in one piece where it is.
+ */
+static bool holds_resume(emit_t *e, unsigned begin) {
+    if(e->prefix == NULL) return false;
+    return begin < e->prefix->resume && e->prefix->resume <= e->ir->items[begin].match;
+}
 
-    // If the first instruction is a branch, always skip it (unreachable).
-    unsigned offset = 0;
-    if(tokens->items[0]->type == BRANCH) {
-        ASM_INFO(asm_info, out, "optimized away unreachable branch");
-        offset = 1;
+/**
+ * returns whether a loop is unrolled: a hot innermost loop with a short
+ * body, that runs several iterations each time it is entered. The report
+ * counts whole iterations, so it keeps loops as they are.
+ */
+static bool unrolls(emit_t *e, unsigned begin) {
+    ir_t *ins = &e->ir->items[begin];
+    if(e->info->profile == NULL || e->info->report || ins->match - begin - 1 > UNROLL_BODY || holds_resume(e, begin)) {
+        return false;
     }
 
-    parse_branch(asm_info, tokens, out, offset);
+    for(unsigned i = begin + 1; i < ins->match; ++i) {
+        if(e->ir->items[i].op == IR_LOOP_BEGIN) return false;
+    }
 
-    ASM_INFO(asm_info, out, "footer");
-    asm_footer(asm_info, out);
+    return profile_hot(e->info->profile, ins->label) && profile_trips(e->info->profile, ins->label) >= UNROLL_TRIPS;
 }
 
+static void emit_ins(emit_t *e, ir_t *ins) {
+    asm_info_t *asm_info = e->info;
+    x86_as_t *as = e->as;
+
+    switch (ins->op) {
+    case IR_ADD:
+        ASM_INFO(asm_info, as, "inc/dec [%d] %d", ins->off, ins->val);
+        asm_diff(asm_info, as, ins->off, ins->val);
+        break;
+    case IR_SET:
+        ASM_INFO(asm_info, as, "set [%d] %d", ins->off, ins->val);
+        asm_set(asm_info, as, ins->off, ins->val);
+        break;
+    case IR_MUL_ADD:
+        ASM_INFO(asm_info, as, "add [%d] * %d to [%d]", ins->src, ins->val, ins->off);
+        if(ins->val == 1) asm_copy(asm_info, as, ins->src, ins->off);
+        else asm_mult(asm_info, as, ins->val, ins->src, ins->off);
+        break;
+    case IR_MOVE:
+        ASM_INFO(asm_info, as, "mov %d", ins->val);
+        asm_move(asm_info, as, ins->val);
+        break;
+    case IR_SCAN:
+        ASM_INFO(asm_info, as, "scan %d", ins->val);
+        asm_scan(asm_info, as, ins->val, ins->label, profile_hot(asm_info->profile, ins->label));
+        break;
+    case IR_READ:
+        assert(ins->off == 0);
+        ASM_INFO(asm_info, as, "read");
+        asm_read(asm_info, as);
+        break;
+    case IR_WRITE:
+        ASM_INFO(asm_info, as, "write [%d]", ins->off);
+        asm_write(asm_info, as, ins->off);
+        break;
+    case IR_LOOP_BEGIN:
+        ASM_INFO(asm_info, as, "branch %u begin", ins->label);
+        asm_branch_begin(asm_info, as, ins->label,
+            asm_info->profile != NULL && profile_hot(asm_info->profile, ins->label)
+            && profile_trips(asm_info->profile, ins->label) >= ALIGN_TRIPS);
+        break;
+    case IR_LOOP_END:
+        ASM_INFO(asm_info, as, "branch %u end", ins->label);
+        asm_branch_end(asm_info, as, ins->label);
+        break;
+    }
+}
 
-#define TGETC(l, i) l->children->items[i]
-
-#define IS_INC(t) (t->type == MOD && t->i == 1)
-#define IS_DEC(t) (t->type == MOD && t->i == -1)
-#define IS_MOV(t) (t->type == MOV)
-#define IS_MOV_WITH(t, v) (t->type == MOV && t->i == v)
+// the most adds and sets gathered to find adjacent cells in.
+#define VECTOR_RUN 64
 
 /**
- * [-] is an assign to 0 call.
+ * emits the adds and sets of distinct cells from start on, before stop,
+ * with every stretch of adjacent cells that fills vectors updated at once.
+ * They can be reordered, as none of them touches a cell another one does.
+ * Returns the number of instructions emitted, or 0 if no vector fits.
  */
-bool optimize_assign(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out) {
-    if(tokens->items[*ind]->type != BRANCH) return false;
-    toklist_t *lst = tokens->items[*ind]->children;
-    if(lst->count != 1) return false;
+static unsigned emit_vectors(emit_t *e, unsigned start, unsigned stop) {
+    irlist_t *ir = e->ir;
+    unsigned lanes = asm_vector_cells(e->info);
+
+    // the instructions by offset, sorted as they are gathered.
+    unsigned order[VECTOR_RUN];
+    unsigned n = 0;
+    for(unsigned i = start; i < stop && n < VECTOR_RUN; ++i) {
+        ir_t *ins = &ir->items[i];
+        if(ins->op != IR_ADD && ins->op != IR_SET) break;
+
+        unsigned k = n;
+        while(k > 0 && ir->items[order[k - 1]].off > ins->off) k--;
+        if(k > 0 && ir->items[order[k - 1]].off == ins->off) break;
+
+        memmove(order + k + 1, order + k, (n - k) * sizeof *order);
+        order[k] = i;
+        n++;
+    }
+    if(n < lanes) return 0;
+
+    bool vectored[VECTOR_RUN] = { false };
+    int values[VECTOR_RUN];
+    bool sets[VECTOR_RUN];
+    bool any = false;
+
+    for(unsigned k = 0; k < n;) {
+        unsigned len = 1;
+        while(k + len < n && ir->items[order[k + len]].off == ir->items[order[k]].off + (int) len) len++;
+
+        unsigned count = len - len % lanes;
+        if(count > 0) {
+            for(unsigned j = 0; j < count; ++j) {
+                ir_t *ins = &ir->items[order[k + j]];
+                values[j] = ins->val;
+                sets[j] = (ins->op == IR_SET);
+                vectored[order[k + j] - start] = true;
+            }
 
-    if(lst->items[0]->type == MOD && lst->items[0]->i == -1) {
-        ASM_INFO(info, out, "optimized '[-]' into a 0 assignment");
-        asm_set(info, out, 0);
-        return true;
+            int off = ir->items[order[k]].off;
+            ASM_INFO(e->info, e->as, "vector [%d] to [%d]", off, off + (int) count - 1);
+            asm_vector(e->info, e->as, off, count, values, sets);
+            any = true;
+        }
+        k += len;
+    }
+    if(!any) return 0;
+
+    for(unsigned i = 0; i < n; ++i) {
+        if(!vectored[i]) emit_ins(e, &ir->items[start + i]);
     }
+    return n;
 }
 
 /**
- * [] should be removed
+ * emits the instructions in [from, to). Loops that never iterated in the
+ * profile are left for later when outline is set, and short hot innermost
+ * loops run two copies of their body per iteration. Only hot code keeps cells in registers.
  */
-bool optimize_empty(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out) {
-    tok_t *root = tokens->items[*ind];
-    if(root->type == BRANCH && root->children->count == 0) {
-        ASM_INFO(info, out, "optimized away empty branch");
-        return true;
+static void emit_range(emit_t *e, unsigned from, unsigned to, bool outline) {
+    irlist_t *ir = e->ir;
+    const prefix_t *prefix = e->prefix;
+    const profile_t *profile = e->info->profile;
+    unsigned run = from;
+
+    for(unsigned i = from; i < to; ++i) {
+        ir_t *ins = &ir->items[i];
+
+        bool resumed = (prefix != NULL && i == prefix->resume);
+        if(resumed) asm_resume(e->info, e->as);
+
+        // a run of straight-line code starts here.
+        if(e->info->cache && (i == from || resumed || ends_run(&ir->items[i - 1]) || i == run + CACHE_RUN)) {
+            unsigned stop = (prefix != NULL && prefix->resume > i) ? prefix->resume : ir->count;
+            if(e->hot[e->depth]) plan_cache(e->info, ir, e->as, i, stop);
+            else asm_cache_plan(e->info, e->as, NULL, 0);
+            run = i;
+        }
+
+        // adds and sets of adjacent cells go in vectors, within the run and
+        // before the resume label.
+        if((ins->op == IR_ADD || ins->op == IR_SET) && asm_vector_cells(e->info) > 0) {
+            unsigned stop = to;
+            if(prefix != NULL && prefix->resume > i && prefix->resume < stop) stop = prefix->resume;
+            if(e->info->cache && run + CACHE_RUN < stop) stop = run + CACHE_RUN;
+
+            unsigned n = emit_vectors(e, i, stop);
+            if(n > 0) {
+                i += n - 1;
+                continue;
+            }
+        }
+
+        if(ins->op == IR_LOOP_BEGIN && outline && profile_cold(profile, ins->label) && !holds_resume(e, i)) {
+            ASM_INFO(e->info, e->as, "branch %u outlined", ins->label);
+            asm_branch_outline(e->info, e->as, ins->label);
+            e->outlined[e->outlined_count++] = i;
+            i = ins->match;
+            continue;
+        }
+
+        if(ins->op == IR_LOOP_BEGIN && unrolls(e, i)) {
+            emit_ins(e, ins);
+            e->hot[++e->depth] = true;
+            emit_range(e, i + 1, ins->match, false);
+            ASM_INFO(e->info, e->as, "branch %u unrolled", ins->label);
+            asm_branch_exit(e->info, e->as, ins->label);
+            emit_range(e, i + 1, ins->match, false);
+            e->depth--;
+
+            i = ins->match;
+            run = i;
+            emit_ins(e, &ir->items[i]);
+            continue;
+        }
+
+        emit_ins(e, ins);
+        if(ins->op == IR_LOOP_BEGIN) e->hot[++e->depth] = profile_hot(profile, ins->label);
+        else if(ins->op == IR_LOOP_END) e->depth--;
     }
+}
 
-    return false;
+/**
+ * emits the final ir as assembly, starting at start. The resume label of
+ * an evaluated prefix is placed before the instruction at resume. The
+ * loops laid out after the program when outline is set are emitted by
+ * parse_outlined.
+ */
+static void parse_ir(emit_t *e, unsigned start, bool outline) {
+    // without a profile all code is hot.
+    e->hot[0] = (e->info->profile == NULL);
+    e->depth = 0;
+    emit_range(e, start, e->ir->count, outline);
+
+    if(e->prefix != NULL && e->prefix->resume == e->ir->count) asm_resume(e->info, e->as);
 }
 
 /**
- * [+++>-<][] second parenthesis can be removed.
- * There needs to be some assignment or movement before a new branch.
+ * emits the bodies of the outlined loops, after the end of the program.
+ * Loops within them stay where they are, they never ran either.
  */
-bool optimize_unreachable(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out) {
-    if(*ind == 0) return false;
-    tok_t *prev = tokens->items[*ind - 1];
-    tok_t *curr = tokens->items[*ind];
-    if(prev->type == BRANCH && curr->type == BRANCH) {
-        ASM_INFO(info, out, "optimized away unreachable branch");
-        return true;
+static void parse_outlined(emit_t *e) {
+    for(unsigned i = 0; i < e->outlined_count; ++i) {
+        ir_t *ins = &e->ir->items[e->outlined[i]];
+
+        ASM_INFO(e->info, e->as, "branch %u outlined body", ins->label);
+        asm_outline_begin(e->info, e->as, ins->label);
+        e->hot[0] = false;
+        e->depth = 0;
+        emit_range(e, e->outlined[i] + 1, ins->match, false);
+        asm_outline_end(e->info, e->as, ins->label);
     }
+}
 
-    return false;
+/**
+ * returns where code has to be emitted from to resume at an instruction,
+ * which is the outermost loop containing it. Everything before is dead.
+ */
+static unsigned live_start(irlist_t *ir, unsigned resume) {
+    unsigned depth = 0;
+    unsigned start = resume;
+
+    for(unsigned i = 0; i < resume; ++i) {
+        if(ir->items[i].op == IR_LOOP_BEGIN) {
+            if(depth++ == 0) start = i;
+        } else if(ir->items[i].op == IR_LOOP_END) {
+            depth--;
+        }
+    }
+
+    return (depth > 0) ? start : resume;
 }
 
 /**
- * [-a+b] copies all from current cell to +a, and clears current cell in process.
- * 
- * synonyms:
- * [>>>+<<<-]
- * [->>>+<<<]
+ * finds how far past the last cell it touched the program can reach: the
+ * longest move, and the farthest offset from the pointer after it. Both
+ * only grow with each part of the program.
  */
-bool optimize_copy_to(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out) {
-    tok_t *root = tokens->items[*ind];
-    if(root->type == BRANCH && root->children->count == 4) {
-        int move_size = 0;
+static void tape_reach(irlist_t *ir, int *move, int *off) {
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        switch (ins->op) {
+        case IR_MOVE:
+        case IR_SCAN:
+            if(abs(ins->val) > *move) *move = abs(ins->val);
+            break;
+        case IR_MUL_ADD:
+            if(abs(ins->src) > *off) *off = abs(ins->src);
+            // fallthrough
+        default:
+            if(abs(ins->off) > *off) *off = abs(ins->off);
+            break;
+        }
+    }
+}
 
-        tok_t *first = TGETC(root, 0);
-        tok_t *second = TGETC(root, 1);
-        tok_t *third = TGETC(root, 2);
-        tok_t *fourth = TGETC(root, 3);
+/**
+ * returns the number of loop labels, which a profile has to count the
+ * loops of.
+ */
+static unsigned count_loops(irlist_t *ir) {
+    unsigned loops = 0;
+    for(unsigned i = 0; i < ir->count; ++i) {
+        if(ir->items[i].op == IR_LOOP_BEGIN && ir->items[i].label >= loops) loops = ir->items[i].label + 1;
+    }
+    return loops;
+}
 
-        if(IS_MOV(first)) {
-            move_size = first->i;
-            
-            if(IS_INC(second) && IS_MOV_WITH(third, -move_size) && IS_DEC(fourth)) {
-                ASM_INFO(info, out, "optimized copy to (%d)", move_size);
-                asm_copy(info, out, move_size);
-                asm_set(info, out, 0);
-                return true;
-            }
-        } else if(IS_MOV(second)) {
-            move_size = second->i;
-
-            if(IS_DEC(first) && IS_INC(third) && IS_MOV_WITH(fourth, -move_size)) {
-                ASM_INFO(info, out, "optimized copy to (%d)", move_size);
-                asm_copy(info, out, move_size);
-                asm_set(info, out, 0);
-                return true;
-            }
+/**
+ * finds the instructions each loop runs per iteration, by label from base:
+ * its test and its body, not counting the loops inside it. A scan is one
+ * instruction per cell. sizes has to be zero for the loops in the ir.
+ */
+static void loop_sizes(irlist_t *ir, unsigned *sizes, unsigned base) {
+    unsigned *open = malloc((ir->count + 1) * sizeof *open);
+    if(open == NULL) sys_error("malloc loop sizes");
+    unsigned depth = 0;
+
+    for(unsigned i = 0; i < ir->count; ++i) {
+        ir_t *ins = &ir->items[i];
+        if(ins->op == IR_LOOP_END) {
+            depth--;
+            continue;
         }
+
+        if(depth > 0) sizes[open[depth - 1]]++;
+        if(ins->op == IR_SCAN) sizes[ins->label - base] = 1;
+        if(ins->op == IR_LOOP_BEGIN) {
+            sizes[ins->label - base]++;
+            open[depth++] = ins->label - base;
+        }
+    }
+
+    free(open);
+}
+
+/**
+ * returns the instructions outside of loops from start, which run once.
+ */
+static unsigned long top_size(irlist_t *ir, unsigned start) {
+    unsigned long size = 0;
+    unsigned depth = 0;
+
+    for(unsigned i = start; i < ir->count; ++i) {
+        if(ir->items[i].op == IR_LOOP_END) depth--;
+        else if(depth == 0) size++;
+        if(ir->items[i].op == IR_LOOP_BEGIN) depth++;
+    }
+
+    return size;
+}
+
+/**
+ * finds the source range of each loop, by label from base.
+ */
+static void loop_ranges(toklist_t *tokens, srcrange_t *ranges, unsigned base, unsigned loops) {
+    for(unsigned i = 0; i < tokens->count; ++i) {
+        tok_t *tok = &tokens->items[i];
+        if(tok->type == BRANCH && (unsigned) tok->i < loops) ranges[tok->i - base] = tok->src;
+    }
+}
+
+/**
+ * A part of the program, compiled on its own: its tokens, and the assembly
+ * and what the footer needs to know of it once it is compiled. Parts can be
+ * compiled in any order, on threads of their own, and give the same result
+ * either way.
+ */
+typedef struct {
+    toklist_t tokens;
+    bool first;
+    bool last;
+
+    // a copy of the options, with the state of emitting the part.
+    asm_info_t info;
+    text_t text;
+
+    // whether the part is emitted into the object once it is collected,
+    // instead of to its text right away. The object takes the parts in
+    // order, as the padding of aligned loops depends on where they are.
+    bool assemble;
+
+    // the optimized ir and evaluated prefix waiting to be emitted, and
+    // where the code starts in the ir.
+    irlist_t ir;
+    prefix_t prefix;
+    unsigned start;
+
+    // the loop labels up to loops, the reach and the instructions outside
+    // of loops of the part. The sizes and source ranges of its loops, by
+    // label from base, are only kept for the report.
+    unsigned base;
+    unsigned loops;
+    int move;
+    int off;
+    unsigned long top_size;
+    unsigned *sizes;
+    srcrange_t *ranges;
+
+    // the optimized ir written out for -fdump-ir, which is kept until the
+    // part is collected so the parts are written in order.
+    char *dump;
+    size_t dump_len;
+
+    // whether a worker has compiled the part.
+    bool done;
+} part_t;
+
+/**
+ * returns the first label of the loops in the tokens, or 0 without loops.
+ */
+static unsigned first_label(toklist_t *tokens) {
+    for(unsigned i = 0; i < tokens->count; ++i) {
+        if(tokens->items[i].type == BRANCH) return tokens->items[i].i;
+    }
+    return 0;
+}
+
+/**
+ * emits a compiled part, with the header before the first part. A program
+ * in one part gets its footer here, and only it has loops laid out after
+ * it. Other parts leave no cells in registers, so they do not depend on
+ * each other.
+ */
+static void emit_part(part_t *part, x86_as_t *as) {
+    asm_info_t *asm_info = &part->info;
+    prefix_t *prefix = &part->prefix;
+    bool whole = part->first && part->last;
+
+    if(part->first) {
+        asm_comment(as, "generated by bfc");
+
+        ASM_INFO(asm_info, as, "header");
+        asm_header(asm_info, as);
+    }
+
+    emit_t e = { .info = asm_info, .ir = &part->ir, .as = as };
+    e.hot = malloc((part->ir.count + 1) * sizeof *e.hot);
+    e.outlined = malloc((part->ir.count + 1) * sizeof *e.outlined);
+    if(e.hot == NULL || e.outlined == NULL) sys_error("malloc emitter state");
+
+    if(prefix->resume > 0) {
+        ASM_INFO(asm_info, as, "evaluated at compile time up to instruction %u", prefix->resume);
+        asm_prefix(asm_info, as, prefix);
+        e.prefix = prefix;
     }
+    parse_ir(&e, part->start, whole);
+
+    if(whole) {
+        ASM_INFO(asm_info, as, "footer");
+        asm_footer(asm_info, as);
+        parse_outlined(&e);
+    } else {
+        asm_cache_plan(asm_info, as, NULL, 0);
+    }
+
+    free(e.hot);
+    free(e.outlined);
+    prefix_free(prefix);
+    ir_free(&part->ir);
+    timer_mark("emit");
+}
+
+/**
+ * lowers, optimizes and evaluates a part of the program, and emits it to
+ * its text unless it is assembled later. Only the first part is evaluated,
+ * and a program in one part is weighed by the sizes of its loops.
+ */
+static void compile_part(part_t *part) {
+    asm_info_t *asm_info = &part->info;
+    toklist_t *tokens = &part->tokens;
+    bool first = part->first;
+    bool whole = first && part->last;
+
+    if(whole && tokens->count == 0) error("no tokens to parse. aborting.");
+    asm_info->preceded = !first;
+    asm_info->followed = !part->last;
+
+    irlist_t *ir = &part->ir;
+    *ir = (irlist_t) IRLIST_INIT;
+    ir_lower(ir, tokens);
+    timer_mark("lower");
+
+    // the labels are counted before optimizing, so they do not depend on
+    // the options the profile was generated with.
+    part->base = first_label(tokens);
+    part->loops = count_loops(ir);
+    if(whole && asm_info->profile != NULL && asm_info->profile->count != part->loops) {
+        error("the profile does not match the program");
+    }
+
+    optimize(ir, asm_info);
+    bool sized = asm_info->report || (whole && asm_info->profile != NULL);
+    if(sized) {
+        unsigned count = part->loops - part->base;
+        part->sizes = calloc(count + 1, sizeof *part->sizes);
+        part->ranges = calloc(count + 1, sizeof *part->ranges);
+        if(part->sizes == NULL || part->ranges == NULL) sys_error("malloc loop tables");
+
+        loop_sizes(ir, part->sizes, part->base);
+        loop_ranges(tokens, part->ranges, part->base, part->loops);
+    }
+    if(whole && asm_info->profile != NULL) profile_weigh(asm_info->profile, part->sizes);
+    if(asm_info->dump_ir) {
+        FILE *dump = open_memstream(&part->dump, &part->dump_len);
+        if(dump == NULL) sys_error("open_memstream ir");
+        ir_print(ir, dump);
+        fclose(dump);
+    }
+    toklist_free(tokens);
+    timer_mark("optimize");
+
+    if(first) eval_prefix(ir, asm_info, &part->prefix);
+    timer_mark("evaluate");
+
+    tape_reach(ir, &part->move, &part->off);
+    part->start = (part->prefix.resume > 0) ? live_start(ir, part->prefix.resume) : 0;
+    part->top_size = top_size(ir, part->start);
+
+    asm_info->loops = part->loops;
+    asm_info->tape_reach = part->move + part->off;
+    asm_info->top_size = part->top_size;
+    asm_info->loop_size = part->sizes;
+    asm_info->loop_src = part->ranges;
+    asm_info->loop_base = part->base;
+
+    if(!part->assemble) {
+        x86_as_t as;
+        text_open(&part->text, NULL);
+        x86_begin_text(&as, &part->text);
+        emit_part(part, &as);
+    }
+}
+
+/**
+ * The state of parsing a program in parts. The parts are compiled on a
+ * pool of threads, and their assembly is written in the order of the
+ * source as they finish, so the output does not depend on the number of
+ * threads. At most two parts per thread are held at once. What the footer
+ * needs of the parts is kept.
+ */
+typedef struct {
+    asm_info_t *info;
+    text_t text;
+    unsigned parts;
+
+    // the loop labels, reach and instructions outside of loops of the
+    // parts so far.
+    unsigned loops;
+    int move;
+    int off;
+    unsigned long top_size;
+
+    // the sizes and source ranges of the loops so far, by label, which
+    // only the report uses.
+    unsigned *sizes;
+    srcrange_t *ranges;
+    unsigned capacity;
+
+    // the assembler each part is emitted into, or NULL when it is written
+    // out as assembly.
+    x86_as_t *as;
+
+    // the parts being compiled, by number modulo the size of the ring:
+    // from collected up to taken by the threads, and up to queued waiting
+    // for one.
+    pthread_t *threads;
+    unsigned thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t queue;
+    pthread_cond_t done;
+    part_t **ring;
+    unsigned ring_size;
+    unsigned collected;
+    unsigned taken;
+    unsigned queued;
+    bool stop;
+} parts_t;
+
+/**
+ * makes room for the loops up to a number of labels, zeroed.
+ */
+static void reserve_loops(parts_t *p, unsigned loops) {
+    if(loops <= p->capacity) return;
+
+    unsigned capacity = loops + p->capacity;
+    p->sizes = realloc(p->sizes, (capacity + 1) * sizeof *p->sizes);
+    p->ranges = realloc(p->ranges, (capacity + 1) * sizeof *p->ranges);
+    if(p->sizes == NULL || p->ranges == NULL) sys_error("realloc loop tables");
 
-    return false;
+    memset(p->sizes + p->capacity, 0, (capacity + 1 - p->capacity) * sizeof *p->sizes);
+    memset(p->ranges + p->capacity, 0, (capacity + 1 - p->capacity) * sizeof *p->ranges);
+    p->capacity = capacity;
 }
 
 /**
- * a special case of copy to multiple destinations.
- * 
- * synonyms:
- * [->++>>>+>>>>+++<<<<<<<<]
- * [>++>>>+>>>>+++<<<<<<<<-]
+ * compiles the parts in the ring one after another, until the parts end.
  */
-bool optimize_multiply_to(toklist_t *tokens, unsigned *ind, asm_info_t *info, FILE *out) {
-    tok_t *root = tokens->items[*ind];
-    if(root->type == BRANCH) {
-        // ensure that the block begin/ends with a decrement
-        unsigned start, end, offset;
-        if(IS_DEC(TGETC(root, 0))) {
-            start = 1;
-            end = root->children->count - 1;
-        } else if(IS_DEC(TGETC(root, root->children->count - 1))) {
-            start = 0;
-            end = root->children->count - 2;
-        } else return false;
+static void *compile_parts(void *arg) {
+    parts_t *p = arg;
 
-        // ensure there is an odd amount of tokens
-        if((end + 1 - start) % 2 == 0) return false;
-        unsigned operations = (end - start) / 2;
+    pthread_mutex_lock(&p->lock);
+    for(;;) {
+        while(p->taken == p->queued && !p->stop) pthread_cond_wait(&p->queue, &p->lock);
+        if(p->taken == p->queued) break;
 
-        // read and store
-        int moves_tot = 0;
-        int moves[operations];
-        int factors[operations];
-        
-        for(unsigned i = 0; i < operations; ++i) {
-            unsigned off = start + i*2;
+        part_t *part = p->ring[p->taken++ % p->ring_size];
+        pthread_mutex_unlock(&p->lock);
 
-            tok_t *a = root->children->items[off];
-            tok_t *b = root->children->items[off + 1];
+        compile_part(part);
 
-            if(a->type != MOV || b->type != MOD) return false;
+        pthread_mutex_lock(&p->lock);
+        part->done = true;
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
 
-            moves[i] = a->i;
-            factors[i] = b->i;
+    return NULL;
+}
 
-            moves_tot += a->i;
+/**
+ * starts parsing a program in parts, written to a file, or emitted into
+ * an assembler when out is NULL.
+ */
+static void parts_begin(parts_t *p, asm_info_t *asm_info, FILE *out, x86_as_t *as) {
+    *p = (parts_t) { .info = asm_info, .as = as };
+    text_open(&p->text, out);
+}
 
-            // we might have modified the starting cell in a more
-            // advanced loop. forbid this.
-            if(moves_tot == 0) return false;
+/**
+ * starts the threads the parts are compiled on.
+ */
+static void start_threads(parts_t *p) {
+    p->thread_count = p->info->threads;
+    p->ring_size = 2 * p->thread_count;
+    p->threads = malloc(p->thread_count * sizeof *p->threads);
+    p->ring = malloc(p->ring_size * sizeof *p->ring);
+    if(p->threads == NULL || p->ring == NULL) sys_error("malloc threads");
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->queue, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for(unsigned i = 0; i < p->thread_count; ++i) {
+        int err = pthread_create(&p->threads[i], NULL, compile_parts, p);
+        if(err != 0) {
+            errno = err;
+            sys_error("pthread_create");
         }
+    }
+}
+
+/**
+ * adds what the footer needs of a compiled part, and writes its text or
+ * emits it into the object.
+ */
+static void collect_part(parts_t *p, part_t *part) {
+    if(part->loops > p->loops) p->loops = part->loops;
+    if(part->move > p->move) p->move = part->move;
+    if(part->off > p->off) p->off = part->off;
+    p->top_size += part->top_size;
+
+    if(part->sizes != NULL) {
+        unsigned count = part->loops - part->base;
+        reserve_loops(p, part->loops);
+        memcpy(p->sizes + part->base, part->sizes, count * sizeof *p->sizes);
+        memcpy(p->ranges + part->base, part->ranges, count * sizeof *p->ranges);
+    }
+
+    if(part->dump != NULL) {
+        fwrite(part->dump, 1, part->dump_len, stderr);
+        free(part->dump);
+    }
+
+    if(part->assemble) {
+        emit_part(part, p->as);
+    } else {
+        text_write(&p->text, part->text.data, part->text.len);
+        text_close(&part->text);
+    }
+
+    free(part->sizes);
+    free(part->ranges);
+    free(part);
+}
+
+/**
+ * collects the oldest part in the ring once it is compiled.
+ */
+static void collect_next(parts_t *p) {
+    pthread_mutex_lock(&p->lock);
+    part_t *part = p->ring[p->collected % p->ring_size];
+    while(!part->done) pthread_cond_wait(&p->done, &p->lock);
+    p->collected++;
+    pthread_mutex_unlock(&p->lock);
+
+    collect_part(p, part);
+}
 
-        // ensure that the last move placed us at start.
-        tok_t *ptr_restore = TGETC(root, end);
-        if(!IS_MOV_WITH(ptr_restore, -moves_tot)) return false;
+/**
+ * compiles the next part of the program, which takes over the tokens.
+ */
+static void parse_part(parts_t *p, toklist_t *tokens, bool last) {
+    part_t *part = calloc(1, sizeof *part);
+    if(part == NULL) sys_error("malloc part");
+
+    part->tokens = *tokens;
+    *tokens = (toklist_t) TOKLIST_INIT;
+    part->first = (p->parts++ == 0);
+    part->last = last;
+    part->info = *p->info;
+    part->info.part = p->parts - 1;
+    part->assemble = (p->as != NULL);
+
+    // parts are only compiled on threads of their own when there are
+    // several.
+    bool whole = part->first && last;
+    if(p->threads == NULL && p->info->threads > 1 && !whole) start_threads(p);
+    if(p->threads == NULL) {
+        compile_part(part);
+        collect_part(p, part);
+        return;
+    }
 
-        ASM_INFO(info, out, "optimizing %u multiplications", operations);
+    if(p->queued - p->collected == p->ring_size) collect_next(p);
 
-        int mov_accum = 0;
-        for(int i = 0; i < operations; ++i) {
-            mov_accum += moves[i];
-            asm_mult(info, out, factors[i], mov_accum);
+    pthread_mutex_lock(&p->lock);
+    p->ring[p->queued++ % p->ring_size] = part;
+    pthread_cond_signal(&p->queue);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * waits for the parts still being compiled, and writes the footer after
+ * them unless the program was compiled in one part.
+ */
+static void parts_end(parts_t *p) {
+    if(p->threads != NULL) {
+        while(p->collected < p->queued) collect_next(p);
+
+        pthread_mutex_lock(&p->lock);
+        p->stop = true;
+        pthread_cond_broadcast(&p->queue);
+        pthread_mutex_unlock(&p->lock);
+
+        for(unsigned i = 0; i < p->thread_count; ++i) pthread_join(p->threads[i], NULL);
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->queue);
+        pthread_cond_destroy(&p->done);
+        free(p->threads);
+        free(p->ring);
+    }
+
+    asm_info_t *asm_info = p->info;
+    if(p->parts > 1) {
+        if(asm_info->profile != NULL && asm_info->profile->count != p->loops) {
+            error("the profile does not match the program");
         }
 
-        asm_set(info, out, 0);
-        return true;
+        asm_info->loops = p->loops;
+        asm_info->tape_reach = p->move + p->off;
+        asm_info->top_size = p->top_size;
+        asm_info->loop_size = p->sizes;
+        asm_info->loop_src = p->ranges;
+        asm_info->loop_base = 0;
+
+        x86_as_t text_as;
+        x86_as_t *as = p->as;
+        if(as == NULL) {
+            x86_begin_text(&text_as, &p->text);
+            as = &text_as;
+        }
+
+        ASM_INFO(asm_info, as, "footer");
+        asm_footer(asm_info, as);
+    }
+
+    text_close(&p->text);
+    free(p->sizes);
+    free(p->ranges);
+    asm_info->loop_src = NULL;
+    asm_info->loop_size = NULL;
+}
+
+/**
+ * compiles the tokens from start up to stop as the next part of a program,
+ * with the ends of their branches counted from start.
+ */
+static void copy_part(parts_t *p, toklist_t *tokens, unsigned start, unsigned stop, bool last) {
+    toklist_t part = { .capacity = stop - start, .count = stop - start };
+    part.items = malloc((part.count + 1) * sizeof *part.items);
+    if(part.items == NULL) sys_error("malloc part tokens");
+
+    memcpy(part.items, tokens->items + start, part.count * sizeof *part.items);
+    for(unsigned i = 0; i < part.count; ++i) {
+        if(part.items[i].type == BRANCH) part.items[i].end -= start;
+    }
+    parse_part(p, &part, last);
+}
+
+/**
+ * compiles a whole program in parts, split between the loops outside of
+ * all others once a part has STREAM_WINDOW tokens, as a streamed source
+ * is. Only the first part is evaluated, so it runs past the first read,
+ * where the evaluation stops anyway. A program with a profile is kept
+ * whole, as the profile weighs and lays out the loops of all of it.
+ */
+static void parse_split(parts_t *p, toklist_t *tokens) {
+    unsigned start = 0;
+    unsigned from = 0;
+    if(p->info->eval_steps > 0) {
+        while(from < tokens->count && tokens->items[from].type != READ) from++;
+    }
+
+    unsigned next;
+    for(unsigned i = 0; i < tokens->count && p->info->profile == NULL; i = next) {
+        next = (tokens->items[i].type == BRANCH) ? tokens->items[i].end : i + 1;
+        if(i <= from || i - start < STREAM_WINDOW) continue;
+
+        copy_part(p, tokens, start, i, false);
+        start = i;
     }
 
-    return false;
-}
\ No newline at end of file
+    if(start == 0) parse_part(p, tokens, true);
+    else copy_part(p, tokens, start, tokens->count, true);
+}
+
+static void stream_part(toklist_t *tokens, bool last, void *ctx) {
+    parts_t *p = ctx;
+    timer_mark("tokenize");
+    parse_part(p, tokens, last);
+}
+
+void parse(asm_info_t *asm_info, toklist_t *tokens, FILE *out) {
+    parts_t p;
+    parts_begin(&p, asm_info, out, NULL);
+    parse_split(&p, tokens);
+    parts_end(&p);
+}
+
+void parse_object(asm_info_t *asm_info, toklist_t *tokens, x86_obj_t *obj) {
+    x86_as_t as;
+    x86_begin(&as, obj);
+
+    parts_t p;
+    parts_begin(&p, asm_info, NULL, &as);
+    parse_split(&p, tokens);
+    parts_end(&p);
+
+    x86_end(&as);
+}
+
+void parse_stream(asm_info_t *asm_info, FILE *in, FILE *out) {
+    toklist_t tokens = TOKLIST_INIT;
+    parts_t p;
+    parts_begin(&p, asm_info, out, NULL);
+    tokenize_parts(&tokens, in, asm_info->stream_window, stream_part, &p);
+    parts_end(&p);
+    toklist_free(&tokens);
+}
+
+void parse_stream_object(asm_info_t *asm_info, FILE *in, x86_obj_t *obj) {
+    x86_as_t as;
+    x86_begin(&as, obj);
+
+    toklist_t tokens = TOKLIST_INIT;
+    parts_t p;
+    parts_begin(&p, asm_info, NULL, &as);
+    tokenize_parts(&tokens, in, asm_info->stream_window, stream_part, &p);
+    parts_end(&p);
+    toklist_free(&tokens);
+
+    x86_end(&as);
+}
+
+void parse_c(asm_info_t *asm_info, toklist_t *tokens, FILE *out) {
+    if(tokens->count == 0) error("no tokens to parse. aborting.");
+
+    irlist_t ir = IRLIST_INIT;
+    ir_lower(&ir, tokens);
+    timer_mark("lower");
+
+    optimize(&ir, asm_info);
+    if(asm_info->dump_ir) ir_print(&ir, stderr);
+    timer_mark("optimize");
+
+    prefix_t prefix = { 0 };
+    eval_prefix(&ir, asm_info, &prefix);
+    timer_mark("evaluate");
+
+    text_t text;
+    text_open(&text, out);
+    unsigned start = (prefix.resume > 0) ? live_start(&ir, prefix.resume) : 0;
+    cgen_program(asm_info, &text, &ir, start, (prefix.resume > 0) ? &prefix : NULL);
+    text_close(&text);
+
+    prefix_free(&prefix);
+    ir_free(&ir);
+    timer_mark("emit");
+}
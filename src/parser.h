@@ -9,5 +9,29 @@
 
 #include "token.h"
 #include "asm.h"
+#include "x86.h"
+
+// the tokens in a part of a streamed source unless told otherwise.
+#define STREAM_WINDOW 65536
 
 void parse(asm_info_t *asm_info, toklist_t *tokens, FILE *out);
+
+/**
+ * parses the tokens and assembles the result into an object, without
+ * going through a file.
+ */
+void parse_object(asm_info_t *asm_info, toklist_t *tokens, x86_obj_t *obj);
+
+/**
+ * tokenizes, parses and emits a source as it is read, in parts of about
+ * asm_info->stream_window tokens. Each part is freed before the next one
+ * is read, so memory depends on the largest part instead of the whole
+ * source.
+ */
+void parse_stream(asm_info_t *asm_info, FILE *in, FILE *out);
+void parse_stream_object(asm_info_t *asm_info, FILE *in, x86_obj_t *obj);
+
+/**
+ * parses the tokens and writes the program as C instead of assembly.
+ */
+void parse_c(asm_info_t *asm_info, toklist_t *tokens, FILE *out);
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err.h"
+
+// the hot loops are the busiest ones that together do this share of the
+// work of all loops, in percent.
+#define HOT_PERCENT 99
+
+static int compare_desc(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x < y) - (x > y);
+}
+
+void profile_weigh(profile_t *profile, const unsigned *sizes) {
+    uint64_t *sorted = malloc((profile->count + 1) * sizeof *sorted);
+    if(sorted == NULL) sys_error("malloc profile");
+
+    double total = 0;
+    for(unsigned i = 0; i < profile->count; ++i) {
+        uint64_t n = profile->iterations[i];
+        uint64_t size = (sizes != NULL) ? sizes[i] : 1;
+        profile->weights[i] = (size > 0 && n > UINT64_MAX / size) ? UINT64_MAX : n * size;
+        sorted[i] = profile->weights[i];
+        total += sorted[i];
+    }
+
+    // going from the busiest loop, until the hot share is covered.
+    qsort(sorted, profile->count, sizeof *sorted, compare_desc);
+    double sum = 0;
+    profile->hot_min = 1;
+    for(unsigned i = 0; i < profile->count && sum < total * HOT_PERCENT / 100; ++i) {
+        sum += sorted[i];
+        if(sorted[i] > 0) profile->hot_min = sorted[i];
+    }
+
+    free(sorted);
+}
+
+void profile_load(profile_t *profile, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) sys_error("fopen profile '%s'", path);
+
+    char magic[PROFILE_MAGIC_LEN];
+    uint64_t count;
+    if(fread(magic, 1, sizeof magic, fp) != sizeof magic || memcmp(magic, PROFILE_MAGIC, sizeof magic) != 0
+        || fread(&count, sizeof count, 1, fp) != 1 || count > UINT32_MAX) {
+        error("'%s' is not a profile", path);
+    }
+
+    // the counts are stored as pairs.
+    uint64_t *pairs = malloc((count + 1) * 2 * sizeof *pairs);
+    if(pairs == NULL) sys_error("malloc profile");
+    if(fread(pairs, 2 * sizeof *pairs, count, fp) != count) error("profile '%s' is truncated", path);
+    fclose(fp);
+
+    profile->count = count;
+    profile->entries = malloc((count + 1) * sizeof *profile->entries);
+    profile->iterations = malloc((count + 1) * sizeof *profile->iterations);
+    profile->weights = malloc((count + 1) * sizeof *profile->weights);
+    if(profile->entries == NULL || profile->iterations == NULL || profile->weights == NULL) {
+        sys_error("malloc profile");
+    }
+
+    for(unsigned i = 0; i < count; ++i) {
+        profile->entries[i] = pairs[2 * i];
+        profile->iterations[i] = pairs[2 * i + 1];
+    }
+
+    free(pairs);
+    profile_weigh(profile, NULL);
+}
+
+void profile_free(profile_t *profile) {
+    free(profile->entries);
+    free(profile->iterations);
+    free(profile->weights);
+    profile->entries = NULL;
+    profile->iterations = NULL;
+    profile->weights = NULL;
+    profile->count = 0;
+}
+
+bool profile_hot(const profile_t *profile, unsigned label) {
+    if(profile == NULL) return true;
+    if(label >= profile->count) return false;
+
+    return profile->weights[label] >= profile->hot_min;
+}
+
+bool profile_cold(const profile_t *profile, unsigned label) {
+    if(profile == NULL) return false;
+    return label >= profile->count || profile->iterations[label] == 0;
+}
+
+uint64_t profile_trips(const profile_t *profile, unsigned label) {
+    if(profile == NULL || label >= profile->count || profile->entries[label] == 0) return 0;
+    return profile->iterations[label] / profile->entries[label];
+}
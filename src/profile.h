@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the first bytes of a profile file. The magic is followed by the number
+// of loops as a quad, and a pair of quads for each loop: how often the loop
+// was entered, and how many iterations it ran in total.
+#define PROFILE_MAGIC "bfcprof1"
+#define PROFILE_MAGIC_LEN 8
+
+// the file profiles are written to and read from unless told otherwise.
+#define PROFILE_DEFAULT_PATH "bfc.prof"
+
+/**
+ * The counts of every loop in a run of a program built with
+ * -fprofile-generate, by label. The iterations of a scan are the number of
+ * cells it moved past.
+ */
+typedef struct {
+    unsigned count;
+    uint64_t *entries;
+    uint64_t *iterations;
+
+    // the work done in each loop, and the least work of a hot loop.
+    uint64_t *weights;
+    uint64_t hot_min;
+} profile_t;
+
+/**
+ * reads a profile file, which must be one written by a generated program.
+ */
+void profile_load(profile_t *profile, const char *path);
+void profile_free(profile_t *profile);
+
+/**
+ * weighs the iterations of each loop by the size of its body, by label,
+ * which decides the hot loops. A loaded profile counts every iteration the
+ * same.
+ */
+void profile_weigh(profile_t *profile, const unsigned *sizes);
+
+/**
+ * returns whether a loop is among the few busiest ones, which do almost all
+ * of the work. Without a profile every loop is hot.
+ */
+bool profile_hot(const profile_t *profile, unsigned label);
+
+/**
+ * returns whether the profile shows a loop never running its body.
+ */
+bool profile_cold(const profile_t *profile, unsigned label);
+
+/**
+ * returns the average number of iterations a loop ran each time it was
+ * entered, or 0 without a profile.
+ */
+uint64_t profile_trips(const profile_t *profile, unsigned label);
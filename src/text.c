@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "text.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "err.h"
+
+void text_open(text_t *text, FILE *out) {
+    text->out = out;
+    text->len = 0;
+    text->capacity = TEXT_BUFFER;
+    text->data = malloc(text->capacity);
+    if(text->data == NULL) sys_error("malloc text buffer");
+}
+
+void text_close(text_t *text) {
+    text_flush(text);
+    free(text->data);
+    text->data = NULL;
+    text->len = text->capacity = 0;
+}
+
+void text_flush(text_t *text) {
+    if(text->out == NULL || text->len == 0) return;
+
+    if(fwrite(text->data, 1, text->len, text->out) != text->len) sys_error("write assembly");
+    text->len = 0;
+}
+
+/**
+ * makes room for len more bytes, by flushing or growing the buffer.
+ */
+static void reserve(text_t *text, size_t len) {
+    if(text->len + len <= text->capacity) return;
+
+    text_flush(text);
+    if(text->len + len <= text->capacity) return;
+
+    text->capacity = 2 * (text->len + len);
+    text->data = realloc(text->data, text->capacity);
+    if(text->data == NULL) sys_error("realloc text buffer");
+}
+
+void text_write(text_t *text, const char *str, size_t len) {
+    if(text->len + len > text->capacity) reserve(text, len);
+    memcpy(text->data + text->len, str, len);
+    text->len += len;
+}
+
+// the most characters of a formatted long, with its sign.
+#define INT_CHARS 21
+
+/**
+ * formats a number with a sign in front, right into the buffer.
+ */
+static void put_number(text_t *text, unsigned long value, bool negative) {
+    if(text->len + INT_CHARS > text->capacity) reserve(text, INT_CHARS);
+
+    // the digits are counted first, and written from the back.
+    unsigned digits = 1;
+    for(unsigned long v = value; v >= 10; v /= 10) digits++;
+
+    char *p = text->data + text->len;
+    if(negative) *p++ = '-';
+    text->len = p + digits - text->data;
+
+    p += digits;
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while(value != 0);
+}
+
+void text_uint(text_t *text, unsigned long value) {
+    put_number(text, value, false);
+}
+
+void text_int(text_t *text, long value) {
+    if(value < 0) put_number(text, -(unsigned long) value, true);
+    else put_number(text, value, false);
+}
+
+void text_vprintf(text_t *text, const char *fmt, va_list args) {
+    const char *run = fmt;
+
+    for(const char *p; (p = strchr(run, '%')) != NULL;) {
+        // the text up to the conversion is copied as it is.
+        text_write(text, run, p - run);
+        p++;
+
+        bool wide = (*p == 'l' || *p == 'z');
+        char size = *p;
+        if(wide) p++;
+
+        switch (*p) {
+        case 'd':
+            text_int(text, (size == 'l') ? va_arg(args, long) : (size == 'z') ? (long) va_arg(args, size_t) : va_arg(args, int));
+            break;
+        case 'u':
+            text_uint(text, (size == 'l') ? va_arg(args, unsigned long) : (size == 'z') ? va_arg(args, size_t) : va_arg(args, unsigned));
+            break;
+        case 's': {
+            const char *str = va_arg(args, const char *);
+            text_write(text, str, strlen(str));
+        } break;
+        case 'c': {
+            char c = va_arg(args, int);
+            text_write(text, &c, 1);
+        } break;
+        case '%':
+            text_write(text, "%", 1);
+            break;
+        default:
+            error("unknown conversion in '%s'", fmt);
+        }
+
+        run = p + 1;
+    }
+
+    text_write(text, run, strlen(run));
+}
+
+void text_printf(text_t *text, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    text_vprintf(text, fmt, args);
+    va_end(args);
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+// the bytes buffered before they are written to a file.
+#define TEXT_BUFFER (1 << 20)
+
+/**
+ * A buffer the assembly is written to. It is flushed to the file in large
+ * chunks whenever it fills up, or grows to hold everything when there is
+ * no file.
+ */
+typedef struct {
+    FILE *out;
+    char *data;
+    size_t len;
+    size_t capacity;
+} text_t;
+
+void text_open(text_t *text, FILE *out);
+
+/**
+ * writes out what is buffered, and frees the buffer.
+ */
+void text_close(text_t *text);
+void text_flush(text_t *text);
+
+void text_write(text_t *text, const char *str, size_t len);
+
+/**
+ * writes a string literal, or literals pasted together, with the length
+ * known up front.
+ */
+#define TEXT_LIT(text, lit) text_write(text, lit, sizeof(lit) - 1)
+
+void text_int(text_t *text, long value);
+void text_uint(text_t *text, unsigned long value);
+
+/**
+ * formats like printf, but only knows %d, %u, %ld, %lu, %zu, %s, %c and
+ * %%, without flags or widths.
+ */
+void text_printf(text_t *text, const char *fmt, ...);
+void text_vprintf(text_t *text, const char *fmt, va_list args);
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "timer.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define MAX_PHASES 16
+
+static bool enabled = false;
+static double last;
+
+// only the thread that enabled the timer marks phases, as the parts
+// compiled on other threads run at the same time as its phases.
+static pthread_t owner;
+
+static unsigned phase_count = 0;
+static const char *phase_names[MAX_PHASES];
+static double phase_times[MAX_PHASES];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void timer_enable(void) {
+    enabled = true;
+    owner = pthread_self();
+    last = now();
+}
+
+void timer_mark(const char *phase) {
+    if(!enabled || !pthread_equal(owner, pthread_self())) return;
+
+    double t = now();
+
+    unsigned i = 0;
+    while(i < phase_count && strcmp(phase_names[i], phase) != 0) i++;
+    if(i == phase_count) {
+        if(phase_count == MAX_PHASES) return;
+        phase_names[phase_count++] = phase;
+        phase_times[i] = 0;
+    }
+
+    phase_times[i] += t - last;
+    last = t;
+}
+
+void timer_report(FILE *out) {
+    if(!enabled) return;
+
+    double total = 0;
+    for(unsigned i = 0; i < phase_count; ++i) {
+        fprintf(out, "%-10s %10.6f\n", phase_names[i], phase_times[i]);
+        total += phase_times[i];
+    }
+    fprintf(out, "%-10s %10.6f\n", "total", total);
+    fflush(out);
+}
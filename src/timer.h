@@ -0,0 +1,24 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdio.h>
+
+/**
+ * Times the phases of the compiler for -ftime-report. Until the timer is
+ * enabled, marking a phase does nothing.
+ */
+void timer_enable(void);
+
+/**
+ * ends the running phase, attributing the time since the last mark to it.
+ */
+void timer_mark(const char *phase);
+
+/**
+ * writes the time spent in each phase, in the order they first ran.
+ */
+void timer_report(FILE *out);
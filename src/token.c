@@ -5,230 +5,390 @@
  * https://opensource.org/licenses/MIT
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "token.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "err.h"
 
-toklist_t *toklist_create(void);
-void toklist_add(toklist_t *list, tok_t *tok);
 tok_t *toklist_mk(toklist_t *list, tokentype_e type);
 tok_t *toklist_mk_i(toklist_t *list, tokentype_e type, int i);
-tok_t *toklist_mk_n(toklist_t *list, tokentype_e type, char *n);
 
-#define IS_INSTR(ch) (c == '+' || c == '-' || c == '.' || c == ',' || c == '<' \
-    || c == '>' || c == '[' || c == ']')
 #define IS_MOV(ch) ((char) ch == '<' || (char) ch == '>')
 #define IS_VAL(ch) ((char) ch == '-' || (char) ch == '+')
 
-#define CURR_ROOT scoperoots[block_depth]
-#define CURR_SCOPE scoperoots[block_depth]->children
-#define MAX_DEPTH 1024
-
-char *create_branch_name(tok_t *root, unsigned branch_no);
-
-void tokenize(toklist_t *list, FILE *in) {
-    int mov_accum = 0;
-    int mod_accum = 0;
-
-    tok_t root = {
-        .n = "abba",
-        .children = list,
-    };
-
-    unsigned block_depth = 0;
-    tok_t *scoperoots[MAX_DEPTH] = {&root};
-    int branches[MAX_DEPTH] = {0};
-
-    int c;
-    while((c = fgetc(in)) != EOF) {
-        // If the character is outside the instruction set, skip it.
-        if(!IS_INSTR((char) c)) continue;
-
-        // if we have a move accumulation, and the character is not a
-        // continuation of that, or has reached the end, we must
-        // write it to the program.
-        if(mov_accum != 0 && !IS_MOV(c)) {
-            toklist_mk_i(CURR_SCOPE, MOV, mov_accum);
-            mov_accum = 0;
-        }
+// sources that can not be mapped are read in blocks of this size.
+#define BLOCK_SIZE (1 << 20)
 
-        // if we have a value accumulation, and the character is not a
-        // continuation of that, or is the end, we must
-        // write it to the program.
-        if(mod_accum != 0 && !IS_VAL(c)) {
-            toklist_mk_i(CURR_SCOPE, MOD, mod_accum);
-            mod_accum = 0;
-        }
+static const bool is_instr[256] = {
+    ['+'] = true, ['-'] = true, ['<'] = true, ['>'] = true,
+    ['['] = true, [']'] = true, ['.'] = true, [','] = true
+};
 
-        switch (c) {
-        case '>':
-            mov_accum++;
-            break;
-        case '<':
-            mov_accum--;
-            break;
-        case '+':
-            mod_accum++;
-            break;
-        case '-':
-            mod_accum--;
-            break;
-        case '[': {
-            char *branch_name = create_branch_name(CURR_ROOT, branches[block_depth]);
-            tok_t *new_branch = toklist_mk_n(CURR_SCOPE, BRANCH, branch_name);
-
-            new_branch->children = toklist_create();
-
-            // increase the number of branches on the current level,
-            // and add the new branch to the top of the stack.
-            branches[block_depth]++;
-            scoperoots[++block_depth] = new_branch;
-        } break;
-        case ']':
-            if(block_depth == 0) error("unmatched brackets. aborting.");
-
-            // remove from the branch stack. The memory is not freed as
-            // the scoperoot (branch) is still a child of another.
-            scoperoots[block_depth--] = NULL;
-            break;
-        case '.':
-            toklist_mk(CURR_SCOPE, WRITE);
-            break;
-        case ',':
-            toklist_mk(CURR_SCOPE, READ);
-            break;
-        }
+typedef struct {
+    toklist_t *list;
+    int mov_accum;
+    int mod_accum;
+
+    // whether a run of moves or values is pending, and where it began. A
+    // run ends at the last instruction character before it is flushed.
+    bool mov_run;
+    bool mod_run;
+    srcpos_t mov_begin;
+    srcpos_t mod_begin;
+
+    // the offset of the current block in the source, the current line and
+    // the offset it starts at, and the last instruction character.
+    size_t offset;
+    unsigned line;
+    size_t line_start;
+    srcpos_t last;
+
+    // the indices of the open branches, and the number of branches so far.
+    unsigned depth;
+    unsigned capacity;
+    unsigned *open;
+    unsigned branches;
+
+    // the tokens pending before a part is passed on, and where to.
+    unsigned window;
+    tokpart_f part;
+    void *ctx;
+} tokenizer_t;
+
+static void flush_mov(tokenizer_t *t) {
+    if(t->mov_accum != 0) {
+        toklist_mk_i(t->list, MOV, t->mov_accum)->src = (srcrange_t) { t->mov_begin, t->last };
+        t->mov_accum = 0;
     }
+    t->mov_run = false;
+}
 
-    // There may be remaining move and value accumulations, but
-    // As we never access this data later we can optimize them out.
-    // Finally, we must dump move and value accumulations if they exist.
-    /*
-    if(mov_accum != 0) {
-        toklist_mk_i(CURR_SCOPE, MOV, mov_accum);
-        mov_accum = 0;
-    }
-    
-    if(mod_accum != 0) {
-        toklist_mk_i(CURR_SCOPE, MOD, mod_accum);
-        mod_accum = 0;
+static void flush_mod(tokenizer_t *t) {
+    if(t->mod_accum != 0) {
+        toklist_mk_i(t->list, MOD, t->mod_accum)->src = (srcrange_t) { t->mod_begin, t->last };
+        t->mod_accum = 0;
     }
-    */
+    t->mod_run = false;
 }
 
-tok_t *toklist_mk(toklist_t *list, tokentype_e type) {
-    tok_t *t = malloc(sizeof *t);
-    if(t == NULL) sys_error("malloc token");
-    t->type = type;
-    t->children = NULL;
-    t->n = NULL;
-    toklist_add(list, t);
+/**
+ * passes the pending tokens on as a part, if there are enough of them
+ * outside of all branches.
+ */
+static void split(tokenizer_t *t) {
+    if(t->list->count < t->window || t->depth > 0) return;
 
-    return t;
+    flush_mov(t);
+    flush_mod(t);
+    t->part(t->list, false, t->ctx);
+    t->list->count = 0;
 }
 
-tok_t *toklist_mk_i(toklist_t *list, tokentype_e type, int i) {
-    tok_t *t = toklist_mk(list, type);
-    t->i = i;
+/**
+ * returns the position of the character at an offset in the source, which
+ * has to be on the current line.
+ */
+static srcpos_t position(tokenizer_t *t, size_t offset) {
+    return (srcpos_t) { .line = t->line, .column = offset - t->line_start + 1 };
+}
 
-    return t;
+static void newline(tokenizer_t *t, size_t offset) {
+    t->line++;
+    t->line_start = offset + 1;
 }
 
-tok_t *toklist_mk_n(toklist_t *list, tokentype_e type, char *n) {
-    tok_t *t = toklist_mk(list, type);
-    t->n = n;
+/**
+ * starts a run of moves or values at first, unless one is pending.
+ */
+static void begin_run(bool *run, srcpos_t *begin, srcpos_t first) {
+    if(!*run) {
+        *run = true;
+        *begin = first;
+    }
+}
 
-    return t;
+static void push_branch(tokenizer_t *t, unsigned index) {
+    if(t->depth == t->capacity) {
+        t->capacity = 64 + 2 * t->capacity;
+        t->open = realloc(t->open, t->capacity * sizeof *t->open);
+        if(t->open == NULL) sys_error("realloc branch stack");
+    }
+
+    t->open[t->depth++] = index;
 }
 
 /**
- * All characters are allowed in identifiers!
+ * adds one instruction character, found at pos.
  */
-static const char encode_table[64] = {
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
-    'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
-    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
-    'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
-    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
-    'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
-    'w', 'x', 'y', 'z', '0', '1', '2', '3',
-    '4', '5', '6', '7', '8', '9', '.', '_'
-};
+static void tokenize_char(tokenizer_t *t, int c, srcpos_t pos) {
+    // if we have a move accumulation, and the character is not a
+    // continuation of that, or has reached the end, we must
+    // write it to the program.
+    if(!IS_MOV(c)) flush_mov(t);
+
+    // if we have a value accumulation, and the character is not a
+    // continuation of that, or is the end, we must
+    // write it to the program.
+    if(!IS_VAL(c)) flush_mod(t);
+
+    t->last = pos;
+
+    switch (c) {
+    case '>':
+        t->mov_accum++;
+        begin_run(&t->mov_run, &t->mov_begin, pos);
+        break;
+    case '<':
+        t->mov_accum--;
+        begin_run(&t->mov_run, &t->mov_begin, pos);
+        break;
+    case '+':
+        t->mod_accum++;
+        begin_run(&t->mod_run, &t->mod_begin, pos);
+        break;
+    case '-':
+        t->mod_accum--;
+        begin_run(&t->mod_run, &t->mod_begin, pos);
+        break;
+    case '[':
+        // branches are numbered in the order they are opened.
+        toklist_mk_i(t->list, BRANCH, t->branches++)->src = (srcrange_t) { pos, pos };
+        push_branch(t, t->list->count - 1);
+        break;
+    case ']': {
+        if(t->depth == 0) error("unmatched brackets at %u:%u. aborting.", pos.line, pos.column);
+
+        // the children of the branch end here.
+        tok_t *branch = &t->list->items[t->open[--t->depth]];
+        branch->end = t->list->count;
+        branch->src.end = pos;
+    } break;
+    case '.':
+        toklist_mk(t->list, WRITE)->src = (srcrange_t) { pos, pos };
+        break;
+    case ',':
+        toklist_mk(t->list, READ)->src = (srcrange_t) { pos, pos };
+        break;
+    }
+}
 
-static unsigned encode(char *field, unsigned len, unsigned val) {
-    unsigned n = val;
-    unsigned i = 0;
-    do {
-        field[i++] = encode_table[n % 64];
-        n = n >> 6;
+#ifdef __SSE2__
+static unsigned popcount(unsigned x) {
+#ifdef __GNUC__
+    return __builtin_popcount(x);
+#else
+    unsigned n = 0;
+    for(; x != 0; x &= x - 1) n++;
+    return n;
+#endif
+}
 
-        if(n > len) error("encode: no space");
-    } while(n > 0);
+static unsigned lowest_bit(unsigned x) {
+#ifdef __GNUC__
+    return __builtin_ctz(x);
+#else
+    unsigned n = 0;
+    while(!(x & 1)) x >>= 1, n++;
+    return n;
+#endif
+}
 
-    return i;
+static unsigned highest_bit(unsigned x) {
+#ifdef __GNUC__
+    return 31 - __builtin_clz(x);
+#else
+    unsigned n = 0;
+    while(x >>= 1) n++;
+    return n;
+#endif
 }
+#endif
 
+/**
+ * tokenizes a block of the source. Sixteen bytes at a time are classified
+ * with vector compares: blocks without instructions are skipped, blocks of
+ * only +- or only <> on one line are counted at once, and others are walked
+ * bit by bit.
+ */
+static void tokenize_block(tokenizer_t *t, const unsigned char *buf, size_t len) {
+    size_t i = 0;
+    size_t base = t->offset;
+
+#ifdef __SSE2__
+    const __m128i plus = _mm_set1_epi8('+'), minus = _mm_set1_epi8('-');
+    const __m128i left = _mm_set1_epi8('<'), right = _mm_set1_epi8('>');
+    const __m128i open = _mm_set1_epi8('['), close = _mm_set1_epi8(']');
+    const __m128i dot = _mm_set1_epi8('.'), comma = _mm_set1_epi8(',');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    for(; i + 16 <= len; i += 16) {
+        split(t);
+        __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+
+        unsigned p = _mm_movemask_epi8(_mm_cmpeq_epi8(v, plus));
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, minus));
+        unsigned l = _mm_movemask_epi8(_mm_cmpeq_epi8(v, left));
+        unsigned r = _mm_movemask_epi8(_mm_cmpeq_epi8(v, right));
+        __m128i rest = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, open), _mm_cmpeq_epi8(v, close)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, dot), _mm_cmpeq_epi8(v, comma)));
+        unsigned other = _mm_movemask_epi8(rest);
+        unsigned lines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+
+        unsigned vals = p | m, movs = l | r;
+        unsigned all = vals | movs | other;
+
+        size_t at = base + i;
+        if(all == vals || all == movs) {
+            // the runs between the newlines are counted at once.
+            bool values = (all == vals);
+            for(;;) {
+                unsigned below = (lines != 0) ? (lines & -lines) - 1 : 0xffff;
+                unsigned run = all & below;
+                if(run != 0) {
+                    srcpos_t first = position(t, at + lowest_bit(run));
+                    if(values) {
+                        flush_mov(t);
+                        t->mod_accum += (int) popcount(p & run) - (int) popcount(m & run);
+                        begin_run(&t->mod_run, &t->mod_begin, first);
+                    } else {
+                        flush_mod(t);
+                        t->mov_accum += (int) popcount(r & run) - (int) popcount(l & run);
+                        begin_run(&t->mov_run, &t->mov_begin, first);
+                    }
+                    t->last = position(t, at + highest_bit(run));
+                }
+
+                if(lines == 0) break;
+                all &= ~below;
+                newline(t, at + lowest_bit(lines));
+                lines &= lines - 1;
+            }
+            continue;
+        }
 
+        for(unsigned bits = all | lines; bits != 0; bits &= bits - 1) {
+            unsigned bit = lowest_bit(bits);
+            if(lines & (1u << bit)) newline(t, at + bit);
+            else tokenize_char(t, buf[i + bit], position(t, at + bit));
+        }
+    }
+#endif
 
+    for(; i < len; ++i) {
+        split(t);
+        if(buf[i] == '\n') newline(t, base + i);
+        else if(is_instr[buf[i]]) tokenize_char(t, buf[i], position(t, base + i));
+    }
 
+    t->offset += len;
+}
 
-char *create_branch_name(tok_t *root, unsigned branch_no) {
-    char *str = malloc(100 * sizeof *str);
-    if(str == NULL) sys_error("malloc branch name");
+/**
+ * tokenizes a whole source. Regular files are mapped and tokenized in one
+ * go when map is set, as long as nothing but a peeked character has been
+ * read from them.
+ */
+static void tokenize_source(tokenizer_t *t, FILE *in, bool map) {
+    struct stat st;
+    int fd = fileno(in);
+    if(map && ftell(in) == 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr != MAP_FAILED) {
+            posix_madvise(addr, st.st_size, POSIX_MADV_SEQUENTIAL);
+            tokenize_block(t, addr, st.st_size);
+            munmap(addr, st.st_size);
+            goto done;
+        }
+    }
 
-    size_t root_len = strlen(root->n);
-    memcpy(str, root->n, root_len);
-    root_len += encode(str + root_len, 100 - root_len, branch_no);
-    str[root_len] = '\0';
+    unsigned char *buf = malloc(BLOCK_SIZE);
+    if(buf == NULL) sys_error("malloc source block");
 
-    return str;
-}
+    size_t n;
+    while((n = fread(buf, 1, BLOCK_SIZE, in)) > 0) tokenize_block(t, buf, n);
+    if(ferror(in)) sys_error("read source");
+    free(buf);
 
-toklist_t *toklist_create(void) {
-    toklist_t *list = malloc(sizeof *list);
-    if(list == NULL) sys_error("malloc toklist");
-    list->capacity = 0;
-    list->count = 0;
-    list->items = NULL;
+done:
+    // There may be remaining move and value accumulations, but
+    // As we never access this data later we can optimize them out.
+    // Branches left open run to the end of the program.
+    while(t->depth > 0) {
+        tok_t *branch = &t->list->items[t->open[--t->depth]];
+        branch->end = t->list->count;
+        branch->src.end = t->last;
+    }
+    free(t->open);
+}
 
-    return list;
+void tokenize(toklist_t *list, FILE *in) {
+    tokenizer_t t = { .list = list, .line = 1, .window = UINT_MAX };
+    tokenize_source(&t, in, true);
 }
 
-void toklist_free(toklist_t *list) {
-    for(int i = 0; i < list->count; ++i) {
-        tok_t *curr = list->items[i];
-        if(curr->children != NULL) {
-            toklist_free(curr->children);
-            free(curr->children);
-        }
-        
-        free(curr);
-    }
+void tokenize_parts(toklist_t *list, FILE *in, unsigned window, tokpart_f part, void *ctx) {
+    tokenizer_t t = { .list = list, .line = 1, .window = window, .part = part, .ctx = ctx };
 
-    free(list->items);
+    // a mapped source would stay resident as it is read, so it is read in
+    // blocks instead.
+    tokenize_source(&t, in, false);
+    part(list, true, ctx);
+    list->count = 0;
 }
 
-void toklist_add(toklist_t *list, tok_t *tok) {
+tok_t *toklist_mk(toklist_t *list, tokentype_e type) {
     list->count++;
 
     if(list->count > list->capacity) {
-        list->capacity = 32 + 2 * list->count;
+        list->capacity = 1024 + 2 * list->count;
         list->items = realloc(list->items, list->capacity * sizeof *list->items);
         if(list->items == NULL) sys_error("realloc toklist items");
     }
 
-    list->items[list->count - 1] = tok;
+    tok_t *t = &list->items[list->count - 1];
+    t->type = type;
+    t->i = 0;
+    t->end = 0;
+    t->src = (srcrange_t) { { 0, 0 }, { 0, 0 } };
+
+    return t;
 }
 
+tok_t *toklist_mk_i(toklist_t *list, tokentype_e type, int i) {
+    tok_t *t = toklist_mk(list, type);
+    t->i = i;
+
+    return t;
+}
 
+void toklist_free(toklist_t *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = list->capacity = 0;
+}
 
+void print_tok_tree(toklist_t *list, FILE *out) {
+    // the ends of the open branches, innermost last.
+    unsigned *ends = malloc((list->count + 1) * sizeof *ends);
+    if(ends == NULL) sys_error("malloc branch ends");
+    unsigned depth = 0;
 
-void print_tok_tree_part(toklist_t *list, FILE *out, unsigned depth) {
-    for(int i = 0; i < list->count; ++i) {
-        tok_t *tok = list->items[i];
+    for(unsigned i = 0; i < list->count; ++i) {
+        while(depth > 0 && ends[depth - 1] == i) depth--;
+        tok_t *tok = &list->items[i];
 
         const char *name;
         switch (tok->type) {
@@ -239,16 +399,10 @@ void print_tok_tree_part(toklist_t *list, FILE *out, unsigned depth) {
         case WRITE: name = "WRITE"; break;
         }
 
-        if(tok->type == BRANCH) {
-            printf("%*s%s: n='%s'\n", depth, "", name, tok->n);
-            print_tok_tree_part(tok->children, out, depth + 2);
-        } else {
-            printf("%*s%s: i=%d\n", depth, "", name, tok->i);
-        }
+        fprintf(out, "%*s%s: i=%d at %u:%u-%u:%u\n", 2 * depth, "", name, tok->i,
+            tok->src.begin.line, tok->src.begin.column, tok->src.end.line, tok->src.end.column);
+        if(tok->type == BRANCH) ends[depth++] = tok->end;
     }
-}
 
-
-void print_tok_tree(toklist_t *list, FILE *out) {
-    print_tok_tree_part(list, out, 0);
+    free(ends);
 }
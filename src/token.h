@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdbool.h>
 
 typedef enum {
     MOV,
@@ -15,27 +16,60 @@ typedef enum {
     WRITE
 } tokentype_e;
 
-typedef struct toklist_t toklist_t;
+/**
+ * A position in the source, counted from line 1 and column 1. Columns
+ * count bytes.
+ */
+typedef struct {
+    unsigned line;
+    unsigned column;
+} srcpos_t;
+
+/**
+ * The characters a token was made from, from the first to the last. A
+ * branch ends at its closing bracket.
+ */
+typedef struct {
+    srcpos_t begin;
+    srcpos_t end;
+} srcrange_t;
 
+/**
+ * Tokens are stored flat, in program order. The children of a branch
+ * directly follow it, up to the token at end.
+ */
 typedef struct {
     tokentype_e type;
-    union {
-        int i;
-        char *n;
-    };
 
-    toklist_t *children;
+    // the amount of a MOV or MOD, or the label number of a BRANCH.
+    int i;
+    unsigned end;
+    srcrange_t src;
 } tok_t;
 
 typedef struct toklist_t {
     unsigned capacity;
     unsigned count;
-    tok_t **items;
+    tok_t *items;
 } toklist_t;
 
 #define TOKLIST_INIT { .capacity = 0, .count = 0, .items = NULL }
 
+/**
+ * receives the tokens of a part of a source, which the callee may change.
+ * last is set for the part at the end of the source, which may be empty.
+ */
+typedef void (*tokpart_f)(toklist_t *list, bool last, void *ctx);
+
 void tokenize(toklist_t *list, FILE *in);
+
+/**
+ * tokenizes a source in parts as it is read. Whenever at least window
+ * tokens are pending outside of all branches, they are passed to part and
+ * the list is emptied, so only one part is held at a time. Runs of moves
+ * and values may be split between parts.
+ */
+void tokenize_parts(toklist_t *list, FILE *in, unsigned window, tokpart_f part, void *ctx);
 void toklist_free(toklist_t *list);
 
 void print_tok_tree(toklist_t *list, FILE *out);
@@ -0,0 +1,1152 @@
+/**
+ * Copyright (c) 2021 Olle Lögdahl
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "x86.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "err.h"
+
+const char *x86_section_names[X86_SECTIONS] = {
+    ".text", ".rodata", ".data", ".bss"
+};
+
+/**
+ * An operand as it is encoded, with its symbol by index.
+ */
+typedef struct {
+    int kind;
+
+    // registers: the number, and the size in bytes.
+    int reg;
+    int size;
+    bool high;
+
+    // immediates and displacements, optionally relative to a symbol.
+    int64_t value;
+    int sym;
+
+    // memory operands, -1 when absent.
+    int base;
+    int index;
+    int scale;
+} operand_t;
+
+#define MAX_OPERANDS 4
+
+typedef x86_as_t as_t;
+
+#define AS_ERROR(...) error("as: " __VA_ARGS__)
+
+/* symbols */
+
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u;
+    while(*name) h = (h ^ (unsigned char) *name++) * 16777619u;
+    return h;
+}
+
+int x86_find(x86_obj_t *obj, const char *name) {
+    if(obj->hash_capacity == 0) return -1;
+
+    unsigned mask = obj->hash_capacity - 1;
+    for(unsigned h = hash_name(name) & mask;; h = (h + 1) & mask) {
+        unsigned slot = obj->hash[h];
+        if(slot == 0) return -1;
+        if(strcmp(obj->syms[slot - 1].name, name) == 0) return slot - 1;
+    }
+}
+
+static void hash_insert(x86_obj_t *obj, unsigned sym) {
+    unsigned mask = obj->hash_capacity - 1;
+    unsigned h = hash_name(obj->syms[sym].name) & mask;
+    while(obj->hash[h] != 0) h = (h + 1) & mask;
+    obj->hash[h] = sym + 1;
+}
+
+/**
+ * returns the symbol with a name, creating it undefined if needed.
+ */
+static unsigned sym_get(x86_obj_t *obj, const char *name) {
+    int found = x86_find(obj, name);
+    if(found >= 0) return found;
+
+    if(obj->sym_count == obj->sym_capacity) {
+        obj->sym_capacity = 64 + 2 * obj->sym_capacity;
+        obj->syms = realloc(obj->syms, obj->sym_capacity * sizeof *obj->syms);
+        if(obj->syms == NULL) sys_error("realloc symbols");
+    }
+
+    // keep the index at most half full.
+    if(2 * (obj->sym_count + 1) > obj->hash_capacity) {
+        free(obj->hash);
+        obj->hash_capacity = (obj->hash_capacity == 0) ? 256 : 2 * obj->hash_capacity;
+        obj->hash = calloc(obj->hash_capacity, sizeof *obj->hash);
+        if(obj->hash == NULL) sys_error("calloc symbol index");
+        for(unsigned i = 0; i < obj->sym_count; ++i) hash_insert(obj, i);
+    }
+
+    unsigned sym = obj->sym_count++;
+    x86_sym_t *s = &obj->syms[sym];
+    s->name = strdup(name);
+    if(s->name == NULL) sys_error("strdup symbol");
+    s->section = -1;
+    s->offset = 0;
+    s->global = false;
+    s->local_label = false;
+
+    hash_insert(obj, sym);
+    return sym;
+}
+
+/**
+ * numeric labels can be redefined. Each definition gets a symbol of its
+ * own, and references pick the previous (b) or next (f) one.
+ */
+static unsigned local_sym(as_t *as, unsigned n, unsigned def) {
+    char name[32];
+    snprintf(name, sizeof name, "%u\002%u", n, def);
+
+    unsigned sym = sym_get(as->obj, name);
+    as->obj->syms[sym].local_label = true;
+    return sym;
+}
+
+static void define_label(as_t *as, unsigned sym) {
+    x86_sym_t *s = &as->obj->syms[sym];
+    if(s->section >= 0) AS_ERROR("symbol '%s' is already defined", s->name);
+
+    s->section = as->section;
+    s->offset = as->obj->sections[as->section].size;
+}
+
+/* emission */
+
+static x86_sec_t *current(as_t *as) {
+    return &as->obj->sections[as->section];
+}
+
+static void reserve(as_t *as, uint64_t n) {
+    x86_sec_t *sec = current(as);
+
+    if(as->section == X86_BSS) {
+        sec->size += n;
+        return;
+    }
+
+    if(sec->size + n > sec->capacity) {
+        sec->capacity = 2 * (sec->size + n) + 256;
+        sec->data = realloc(sec->data, sec->capacity);
+        if(sec->data == NULL) sys_error("realloc section");
+    }
+}
+
+static void emit8(as_t *as, unsigned v) {
+    if(as->section == X86_BSS) AS_ERROR("data in .bss");
+    reserve(as, 1);
+
+    x86_sec_t *sec = current(as);
+    sec->data[sec->size++] = (unsigned char) v;
+}
+
+static void emit_le(as_t *as, uint64_t v, int n) {
+    for(int i = 0; i < n; ++i) emit8(as, (v >> (8 * i)) & 0xff);
+}
+
+static void fill(as_t *as, uint64_t n, unsigned value) {
+    if(as->section == X86_BSS) {
+        if(value != 0) AS_ERROR("data in .bss");
+        reserve(as, n);
+        return;
+    }
+
+    reserve(as, n);
+    x86_sec_t *sec = current(as);
+    memset(sec->data + sec->size, value, n);
+    sec->size += n;
+}
+
+static void add_reloc(as_t *as, x86_reloc_e type, unsigned sym, int64_t addend) {
+    x86_obj_t *obj = as->obj;
+
+    if(obj->reloc_count == obj->reloc_capacity) {
+        obj->reloc_capacity = 64 + 2 * obj->reloc_capacity;
+        obj->relocs = realloc(obj->relocs, obj->reloc_capacity * sizeof *obj->relocs);
+        if(obj->relocs == NULL) sys_error("realloc relocations");
+    }
+
+    x86_reloc_t *r = &obj->relocs[obj->reloc_count++];
+    r->section = as->section;
+    r->offset = current(as)->size;
+    r->sym = sym;
+    r->type = type;
+    r->addend = addend;
+}
+
+/**
+ * emits a value of n bytes, which may be relative to a symbol. Branches
+ * back to a label in the same section do not depend on where it is
+ * placed, and are resolved right away.
+ */
+static void emit_value(as_t *as, int64_t value, int sym, int n, x86_reloc_e type) {
+    if(sym >= 0) {
+        x86_sym_t *s = &as->obj->syms[sym];
+        if(type == X86_PC32 && s->section == as->section) {
+            value += (int64_t) s->offset - (int64_t) current(as)->size;
+        } else {
+            add_reloc(as, type, sym, value);
+            value = 0;
+        }
+    }
+
+    emit_le(as, value, n);
+}
+
+/* encoding */
+
+#define IS_REG(o) ((o)->kind == X86_OP_REG)
+#define IS_GPR(o) ((o)->kind == X86_OP_REG && (o)->size <= 8)
+#define IS_VEC(o) ((o)->kind == X86_OP_REG && (o)->size >= 16)
+#define IS_MEM(o) ((o)->kind == X86_OP_MEM)
+#define IS_IMM(o) ((o)->kind == X86_OP_IMM)
+#define IS_RM(o) (IS_GPR(o) || IS_MEM(o))
+
+#define FITS8(v) ((v) >= -128 && (v) <= 127)
+#define FITS32(v) ((v) >= INT32_MIN && (v) <= INT32_MAX)
+
+typedef struct {
+    int prefix;             // mandatory prefix, or 0
+    int size;               // operand size, 2 adds 0x66 and 8 REX.W
+    unsigned char op[3];
+    int oplen;
+    int reg;                // the reg field of modrm
+    int base_reg;           // a register encoded in the opcode, or 0
+    operand_t *regop;       // the operand in the reg field, if a register
+    operand_t *rm;          // the operand in the rm field
+    int imm_size;
+    operand_t *imm;
+} enc_t;
+
+/**
+ * byte registers %spl-%dil and %r8b-%r15b need a REX prefix, while
+ * %ah-%bh can not be encoded with one.
+ */
+static int byte_rex(operand_t *op) {
+    if(op == NULL || !IS_GPR(op) || op->size != 1) return 0;
+    if(op->high) return -1;
+    return (op->reg >= 4) ? 1 : 0;
+}
+
+static void modrm(as_t *as, int reg, operand_t *rm) {
+    reg &= 7;
+
+    if(IS_REG(rm)) {
+        emit8(as, 0xc0 | reg << 3 | (rm->reg & 7));
+        return;
+    }
+
+    int scale = (rm->scale == 8) ? 3 : (rm->scale == 4) ? 2 : (rm->scale == 2) ? 1 : 0;
+
+    // without a base, the address is an absolute 32 bit displacement.
+    if(rm->base < 0) {
+        emit8(as, 0x04 | reg << 3);
+        int index = (rm->index >= 0) ? rm->index & 7 : 4;
+        emit8(as, scale << 6 | index << 3 | 5);
+        emit_value(as, rm->value, rm->sym, 4, X86_ABS32S);
+        return;
+    }
+
+    int mod;
+    if(rm->sym >= 0) mod = 2;
+    else if(rm->value == 0 && (rm->base & 7) != 5) mod = 0;
+    else if(FITS8(rm->value)) mod = 1;
+    else mod = 2;
+
+    if(rm->index >= 0 || (rm->base & 7) == 4) {
+        emit8(as, mod << 6 | reg << 3 | 4);
+        int index = (rm->index >= 0) ? rm->index & 7 : 4;
+        emit8(as, scale << 6 | index << 3 | (rm->base & 7));
+    } else {
+        emit8(as, mod << 6 | reg << 3 | (rm->base & 7));
+    }
+
+    if(mod == 1) emit8(as, rm->value & 0xff);
+    else if(mod == 2) emit_value(as, rm->value, rm->sym, 4, X86_ABS32S);
+}
+
+static int rex_bits(int reg, operand_t *rm) {
+    int rex = 0;
+    if(reg & 8) rex |= 4;
+    if(rm != NULL && IS_REG(rm) && (rm->reg & 8)) rex |= 1;
+    if(rm != NULL && IS_MEM(rm)) {
+        if(rm->base >= 0 && (rm->base & 8)) rex |= 1;
+        if(rm->index >= 0 && (rm->index & 8)) rex |= 2;
+    }
+    return rex;
+}
+
+static void encode(as_t *as, enc_t *e) {
+    if(e->size == 2) emit8(as, 0x66);
+    if(e->prefix) emit8(as, e->prefix);
+
+    int rex = rex_bits(e->reg, e->rm);
+    if(e->size == 8) rex |= 8;
+    if(e->base_reg & 8) rex |= 1;
+
+    int a = byte_rex(e->regop), b = byte_rex(e->rm);
+    if(rex != 0 || a > 0 || b > 0) {
+        if(a < 0 || b < 0) AS_ERROR("high byte register used with REX prefix");
+        emit8(as, 0x40 | rex);
+    }
+
+    for(int i = 0; i < e->oplen; ++i) emit8(as, e->op[i]);
+    if(e->rm != NULL) modrm(as, e->reg, e->rm);
+
+    if(e->imm_size > 0) {
+        x86_reloc_e type = (e->size == 8) ? X86_ABS32S : X86_ABS32;
+        emit_value(as, e->imm->value, e->imm->sym, e->imm_size, type);
+    }
+}
+
+/**
+ * encodes an instruction with a VEX prefix, used by the AVX instructions.
+ * map is 1 for 0f, 2 for 0f38 and 3 for 0f3a. pp is 0 for no, 1 for 66,
+ * 2 for f3 and 3 for f2 as implied prefix.
+ */
+static void encode_vex(as_t *as, int map, int pp, bool wide, int opcode,
+    int reg, int vvvv, operand_t *rm) {
+    int rex = rex_bits(reg, rm);
+    int r = !(rex & 4), x = !(rex & 2), b = !(rex & 1);
+    int l = wide ? 1 : 0;
+    int v = (~vvvv) & 15;
+
+    if(x && b && map == 1) {
+        emit8(as, 0xc5);
+        emit8(as, r << 7 | v << 3 | l << 2 | pp);
+    } else {
+        emit8(as, 0xc4);
+        emit8(as, r << 7 | x << 6 | b << 5 | map);
+        emit8(as, v << 3 | l << 2 | pp);
+    }
+
+    emit8(as, opcode);
+    modrm(as, reg, rm);
+}
+
+/* instructions */
+
+typedef void (*handler_t)(as_t *as, int arg, int size, operand_t *ops, int n);
+
+typedef struct {
+    const char *name;
+    handler_t handler;
+    int arg;
+
+    // whether the name takes a size suffix.
+    bool sized;
+} mnemonic_t;
+
+static void expect(bool cond) {
+    if(!cond) AS_ERROR("invalid operands");
+}
+
+/**
+ * returns the operand size of an instruction: the suffix if given, and
+ * otherwise the size of its general purpose register operands.
+ */
+static int operand_size(int size, operand_t *ops, int n) {
+    if(size != 0) return size;
+
+    for(int i = n - 1; i >= 0; --i) {
+        if(IS_GPR(&ops[i])) return ops[i].size;
+    }
+
+    AS_ERROR("unknown operand size");
+}
+
+static int imm_size(int size) {
+    return (size == 8) ? 4 : size;
+}
+
+// add, and, sub and cmp, with arg as the /digit.
+static void ins_alu(as_t *as, int arg, int size, operand_t *ops, int n) {
+    expect(n == 2);
+    size = operand_size(size, ops, n);
+    operand_t *src = &ops[0], *dst = &ops[1];
+    int wide = (size != 1);
+
+    enc_t e = { .size = size, .oplen = 1 };
+    if(IS_IMM(src)) {
+        expect(IS_RM(dst));
+        e.reg = arg;
+        e.rm = dst;
+        e.imm = src;
+
+        // the accumulator has short forms without a modrm byte.
+        bool acc = IS_GPR(dst) && dst->reg == 0 && !dst->high;
+        if(acc && (size == 1 || src->sym >= 0 || !FITS8(src->value))) {
+            e.op[0] = arg * 8 + 4 + wide;
+            e.rm = NULL;
+            e.regop = dst;
+            e.imm_size = (size == 1) ? 1 : imm_size(size);
+        } else if(size == 1) {
+            e.op[0] = 0x80;
+            e.imm_size = 1;
+        } else if(src->sym < 0 && FITS8(src->value)) {
+            e.op[0] = 0x83;
+            e.imm_size = 1;
+        } else {
+            e.op[0] = 0x81;
+            e.imm_size = imm_size(size);
+        }
+    } else if(IS_GPR(src)) {
+        expect(IS_RM(dst));
+        e.op[0] = arg * 8 + wide;
+        e.reg = src->reg;
+        e.regop = src;
+        e.rm = dst;
+    } else {
+        expect(IS_MEM(src) && IS_GPR(dst));
+        e.op[0] = arg * 8 + 2 + wide;
+        e.reg = dst->reg;
+        e.regop = dst;
+        e.rm = src;
+    }
+
+    encode(as, &e);
+}
+
+static void ins_mov(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) arg;
+    expect(n == 2);
+    size = operand_size(size, ops, n);
+    operand_t *src = &ops[0], *dst = &ops[1];
+    int wide = (size != 1);
+
+    enc_t e = { .size = size, .oplen = 1 };
+    if(IS_IMM(src)) {
+        expect(IS_RM(dst));
+
+        // only full 64 bit immediates need movabs.
+        if(size == 8 && src->sym < 0 && !FITS32(src->value) && IS_GPR(dst)) {
+            emit8(as, 0x48 | ((dst->reg & 8) ? 1 : 0));
+            emit8(as, 0xb8 + (dst->reg & 7));
+            emit_le(as, src->value, 8);
+            return;
+        }
+
+        // registers take immediates of their own size, except 64 bit ones
+        // which take sign extended 32 bit immediates below.
+        if(IS_GPR(dst) && size != 8) {
+            e.op[0] = ((size == 1) ? 0xb0 : 0xb8) + (dst->reg & 7);
+            e.regop = dst;
+            e.base_reg = dst->reg;
+            e.imm = src;
+            e.imm_size = size;
+            encode(as, &e);
+            return;
+        }
+
+        e.op[0] = 0xc6 + wide;
+        e.reg = 0;
+        e.rm = dst;
+        e.imm = src;
+        e.imm_size = imm_size(size);
+    } else if(IS_GPR(src)) {
+        expect(IS_RM(dst));
+        e.op[0] = 0x88 + wide;
+        e.reg = src->reg;
+        e.regop = src;
+        e.rm = dst;
+    } else {
+        expect(IS_MEM(src) && IS_GPR(dst));
+        e.op[0] = 0x8a + wide;
+        e.reg = dst->reg;
+        e.regop = dst;
+        e.rm = src;
+    }
+
+    encode(as, &e);
+}
+
+static void ins_test(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) arg;
+    expect(n == 2);
+    size = operand_size(size, ops, n);
+    operand_t *src = &ops[0], *dst = &ops[1];
+    int wide = (size != 1);
+
+    expect(IS_GPR(src) && IS_RM(dst));
+
+    enc_t e = { .size = size, .oplen = 1, .reg = src->reg, .regop = src, .rm = dst };
+    e.op[0] = 0x84 + wide;
+    encode(as, &e);
+}
+
+// neg, mul and div, with arg as the /digit.
+static void ins_unary(as_t *as, int arg, int size, operand_t *ops, int n) {
+    expect(n == 1 && IS_RM(&ops[0]));
+    size = operand_size(size, ops, n);
+
+    enc_t e = { .size = size, .oplen = 1, .reg = arg, .rm = &ops[0] };
+    e.op[0] = 0xf6 + (size != 1);
+    encode(as, &e);
+}
+
+// inc and dec, with arg as the /digit.
+static void ins_incdec(as_t *as, int arg, int size, operand_t *ops, int n) {
+    expect(n == 1 && IS_RM(&ops[0]));
+    size = operand_size(size, ops, n);
+
+    enc_t e = { .size = size, .oplen = 1, .reg = arg, .rm = &ops[0] };
+    e.op[0] = 0xfe + (size != 1);
+    encode(as, &e);
+}
+
+static void ins_imul(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) arg;
+    if(n == 1) {
+        ins_unary(as, 5, size, ops, n);
+        return;
+    }
+
+    // otherwise the three operand form, an immediate times a register or
+    // memory into a register.
+    expect(n == 3 && IS_IMM(&ops[0]) && IS_RM(&ops[1]) && IS_GPR(&ops[2]));
+    size = operand_size(size, ops, n);
+    expect(size != 1);
+
+    enc_t e = { .size = size, .oplen = 1, .reg = ops[2].reg, .rm = &ops[1], .imm = &ops[0] };
+    if(ops[0].sym < 0 && FITS8(ops[0].value)) {
+        e.op[0] = 0x6b;
+        e.imm_size = 1;
+    } else {
+        e.op[0] = 0x69;
+        e.imm_size = imm_size(size);
+    }
+    encode(as, &e);
+}
+
+// shl and shr, with arg as the /digit.
+static void ins_shift(as_t *as, int arg, int size, operand_t *ops, int n) {
+    expect(n == 2 && IS_IMM(&ops[0]) && IS_RM(&ops[1]));
+    operand_t *dst = &ops[1];
+    size = operand_size(size, dst, 1);
+    int wide = (size != 1);
+
+    // shifts by one have a form without the immediate.
+    enc_t e = { .size = size, .oplen = 1, .reg = arg, .rm = dst };
+    if(ops[0].value == 1) {
+        e.op[0] = 0xd0 + wide;
+    } else {
+        e.op[0] = 0xc0 + wide;
+        e.imm = &ops[0];
+        e.imm_size = 1;
+    }
+
+    encode(as, &e);
+}
+
+static void ins_lea(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) arg;
+    expect(n == 2 && IS_MEM(&ops[0]) && IS_GPR(&ops[1]));
+    size = operand_size(size, ops, n);
+
+    enc_t e = { .size = size, .oplen = 1, .reg = ops[1].reg, .rm = &ops[0] };
+    e.op[0] = 0x8d;
+    encode(as, &e);
+}
+
+// push and pop, with arg 0 and 1.
+static void ins_stack(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    expect(n == 1);
+    operand_t *op = &ops[0];
+
+    expect(IS_GPR(op) && op->size == 8);
+    if(op->reg & 8) emit8(as, 0x41);
+    emit8(as, (arg ? 0x58 : 0x50) + (op->reg & 7));
+}
+
+// movzbl, zero extending a byte.
+static void ins_movzbl(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) arg;
+    (void) size;
+    expect(n == 2 && IS_RM(&ops[0]) && IS_GPR(&ops[1]));
+    expect(!IS_GPR(&ops[0]) || ops[0].size == 1);
+
+    enc_t e = { .size = ops[1].size, .oplen = 2, .reg = ops[1].reg, .rm = &ops[0] };
+    e.op[0] = 0x0f;
+    e.op[1] = 0xb6;
+    encode(as, &e);
+}
+
+// bsf, bsr and tzcnt. arg holds the prefix and opcode.
+static void ins_bitscan(as_t *as, int arg, int size, operand_t *ops, int n) {
+    expect(n == 2 && IS_RM(&ops[0]) && IS_GPR(&ops[1]));
+    size = operand_size(size, ops, n);
+
+    enc_t e = { .prefix = arg >> 8, .size = size, .oplen = 2, .reg = ops[1].reg, .rm = &ops[0] };
+    e.op[0] = 0x0f;
+    e.op[1] = arg & 0xff;
+    encode(as, &e);
+}
+
+/**
+ * branches. arg is the condition code, or -1 for jmp and -2 for call.
+ * Direct branches always use a 32 bit displacement.
+ */
+static void ins_branch(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    expect(n == 1);
+    operand_t *op = &ops[0];
+
+    expect(IS_MEM(op) && op->base < 0 && op->index < 0);
+    if(arg == -1) emit8(as, 0xe9);
+    else if(arg == -2) emit8(as, 0xe8);
+    else {
+        emit8(as, 0x0f);
+        emit8(as, 0x80 + arg);
+    }
+
+    emit_value(as, op->value - 4, op->sym, 4, X86_PC32);
+}
+
+// instructions without operands. arg holds up to three opcode bytes.
+static void ins_fixed(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    (void) ops;
+    expect(n == 0);
+    if(arg > 0xffff) emit8(as, arg >> 16);
+    if(arg > 0xff) emit8(as, (arg >> 8) & 0xff);
+    emit8(as, arg & 0xff);
+}
+
+/**
+ * sse2 instructions on xmm registers. arg holds the prefix, and the opcodes
+ * of the load (low byte) and store (second byte) forms.
+ */
+static void ins_sse(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    expect(n == 2);
+    int prefix = (arg >> 16) & 0xff;
+    int load = arg & 0xff, store = (arg >> 8) & 0xff;
+
+    enc_t e = { .prefix = prefix, .oplen = 2 };
+    e.op[0] = 0x0f;
+    if(IS_MEM(&ops[1])) {
+        expect(store != 0 && IS_VEC(&ops[0]));
+        e.op[1] = store;
+        e.reg = ops[0].reg;
+        e.rm = &ops[1];
+    } else {
+        expect(IS_REG(&ops[1]) && (IS_VEC(&ops[0]) || IS_MEM(&ops[0])));
+        e.op[1] = load;
+        e.reg = ops[1].reg;
+        e.rm = &ops[0];
+    }
+
+    encode(as, &e);
+}
+
+static void ins_pmovmskb(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    expect(n == 2 && IS_VEC(&ops[0]) && IS_GPR(&ops[1]));
+
+    if(arg) {
+        encode_vex(as, 1, 1, ops[0].size == 32, 0xd7, ops[1].reg, 0, &ops[0]);
+        return;
+    }
+
+    enc_t e = { .prefix = 0x66, .oplen = 2, .reg = ops[1].reg, .rm = &ops[0] };
+    e.op[0] = 0x0f;
+    e.op[1] = 0xd7;
+    encode(as, &e);
+}
+
+/**
+ * avx instructions in the 0f map. arg holds the implied prefix (pp), and
+ * the opcodes of the load (low byte) and store (second byte) forms. Two
+ * operand forms are moves, three operand forms combine two sources.
+ */
+static void ins_avx(as_t *as, int arg, int size, operand_t *ops, int n) {
+    (void) size;
+    int pp = (arg >> 16) & 0xff;
+    int load = arg & 0xff, store = (arg >> 8) & 0xff;
+
+    if(n == 2) {
+        if(IS_MEM(&ops[1])) {
+            expect(store != 0 && IS_VEC(&ops[0]));
+            encode_vex(as, 1, pp, ops[0].size == 32, store, ops[0].reg, 0, &ops[1]);
+        } else {
+            expect(IS_VEC(&ops[1]));
+            encode_vex(as, 1, pp, ops[1].size == 32, load, ops[1].reg, 0, &ops[0]);
+        }
+        return;
+    }
+
+    expect(n == 3 && IS_VEC(&ops[1]) && IS_VEC(&ops[2]));
+    encode_vex(as, 1, pp, ops[2].size == 32, load, ops[2].reg, ops[1].reg, &ops[0]);
+}
+
+#define JCC(ins, name, cc) [ins] = { name, ins_branch, cc, false }
+
+static const mnemonic_t mnemonics[X86_INSTRUCTIONS] = {
+    [X86_ADD] = { "add", ins_alu, 0, true },
+    [X86_AND] = { "and", ins_alu, 4, true },
+    [X86_SUB] = { "sub", ins_alu, 5, true },
+    [X86_CMP] = { "cmp", ins_alu, 7, true },
+    [X86_MOV] = { "mov", ins_mov, 0, true },
+    [X86_TEST] = { "test", ins_test, 0, true },
+    [X86_NEG] = { "neg", ins_unary, 3, true },
+    [X86_MUL] = { "mul", ins_unary, 4, true },
+    [X86_DIV] = { "div", ins_unary, 6, true },
+    [X86_IMUL] = { "imul", ins_imul, 0, true },
+    [X86_INC] = { "inc", ins_incdec, 0, true },
+    [X86_DEC] = { "dec", ins_incdec, 1, true },
+    [X86_SHL] = { "shl", ins_shift, 4, true },
+    [X86_SHR] = { "shr", ins_shift, 5, true },
+    [X86_LEA] = { "lea", ins_lea, 0, true },
+    [X86_PUSH] = { "push", ins_stack, 0, true },
+    [X86_POP] = { "pop", ins_stack, 1, true },
+    [X86_MOVZBL] = { "movzbl", ins_movzbl, 0, false },
+    [X86_BSF] = { "bsf", ins_bitscan, 0xbc, true },
+    [X86_BSR] = { "bsr", ins_bitscan, 0xbd, true },
+    [X86_TZCNT] = { "tzcnt", ins_bitscan, 0xf3bc, true },
+    [X86_JMP] = { "jmp", ins_branch, -1, false },
+    [X86_CALL] = { "call", ins_branch, -2, false },
+    JCC(X86_JB, "jb", 0x2), JCC(X86_JAE, "jae", 0x3), JCC(X86_JE, "je", 0x4),
+    JCC(X86_JZ, "jz", 0x4), JCC(X86_JNE, "jne", 0x5), JCC(X86_JNZ, "jnz", 0x5),
+    JCC(X86_JBE, "jbe", 0x6), JCC(X86_JS, "js", 0x8), JCC(X86_JLE, "jle", 0xe),
+    [X86_RET] = { "ret", ins_fixed, 0xc3, false },
+    [X86_SYSCALL] = { "syscall", ins_fixed, 0x0f05, false },
+    [X86_VZEROUPPER] = { "vzeroupper", ins_fixed, 0xc5f877, false },
+    [X86_REP_MOVSB] = { "rep movsb", ins_fixed, 0xf3a4, false },
+    [X86_REP_STOSB] = { "rep stosb", ins_fixed, 0xf3aa, false },
+    [X86_PXOR] = { "pxor", ins_sse, 0x6600ef, false },
+    [X86_PAND] = { "pand", ins_sse, 0x6600db, false },
+    [X86_PADDB] = { "paddb", ins_sse, 0x6600fc, false },
+    [X86_PADDW] = { "paddw", ins_sse, 0x6600fd, false },
+    [X86_PCMPEQB] = { "pcmpeqb", ins_sse, 0x660074, false },
+    [X86_PCMPEQW] = { "pcmpeqw", ins_sse, 0x660075, false },
+    [X86_PCMPEQD] = { "pcmpeqd", ins_sse, 0x660076, false },
+    [X86_MOVDQU] = { "movdqu", ins_sse, 0xf37f6f, false },
+    [X86_PMOVMSKB] = { "pmovmskb", ins_pmovmskb, 0, false },
+    [X86_VPXOR] = { "vpxor", ins_avx, 0x0100ef, false },
+    [X86_VPAND] = { "vpand", ins_avx, 0x0100db, false },
+    [X86_VPADDB] = { "vpaddb", ins_avx, 0x0100fc, false },
+    [X86_VPADDW] = { "vpaddw", ins_avx, 0x0100fd, false },
+    [X86_VPCMPEQB] = { "vpcmpeqb", ins_avx, 0x010074, false },
+    [X86_VPCMPEQW] = { "vpcmpeqw", ins_avx, 0x010075, false },
+    [X86_VPCMPEQD] = { "vpcmpeqd", ins_avx, 0x010076, false },
+    [X86_VMOVDQU] = { "vmovdqu", ins_avx, 0x027f6f, false },
+    [X86_VPMOVMSKB] = { "vpmovmskb", ins_pmovmskb, 1, false },
+};
+
+/* operands */
+
+x86_op_t x86_reg(int reg, int size) {
+    return (x86_op_t) { .kind = X86_OP_REG, .reg = reg, .size = size, .local = -1, .base = X86_NONE, .index = X86_NONE, .scale = 1 };
+}
+
+x86_op_t x86_high(int reg) {
+    x86_op_t op = x86_reg(reg + 4, 1);
+    op.high = true;
+    return op;
+}
+
+x86_op_t x86_imm(int64_t value) {
+    return (x86_op_t) { .kind = X86_OP_IMM, .value = value, .local = -1, .base = X86_NONE, .index = X86_NONE, .scale = 1 };
+}
+
+x86_op_t x86_imm_sym(const char *sym, int64_t value) {
+    x86_op_t op = x86_imm(value);
+    op.sym = sym;
+    return op;
+}
+
+x86_op_t x86_at_index(int base, int index, int scale) {
+    return (x86_op_t) { .kind = X86_OP_MEM, .local = -1, .base = base, .index = index, .scale = scale };
+}
+
+x86_op_t x86_at(int base) {
+    return x86_at_index(base, X86_NONE, 1);
+}
+
+x86_op_t x86_mem_index(int base, int index, int scale, int64_t disp) {
+    x86_op_t op = x86_at_index(base, index, scale);
+    op.value = disp;
+    op.disp = true;
+    return op;
+}
+
+x86_op_t x86_mem(int base, int64_t disp) {
+    return x86_mem_index(base, X86_NONE, 1, disp);
+}
+
+x86_op_t x86_sym_base(const char *sym, int64_t disp, int base) {
+    x86_op_t op = x86_at(base);
+    op.value = disp;
+    op.sym = sym;
+    return op;
+}
+
+x86_op_t x86_sym(const char *sym, int64_t disp) {
+    return x86_sym_base(sym, disp, X86_NONE);
+}
+
+x86_op_t x86_back(unsigned n) {
+    x86_op_t op = x86_at(X86_NONE);
+    op.local = n;
+    return op;
+}
+
+x86_op_t x86_forward(unsigned n) {
+    x86_op_t op = x86_back(n);
+    op.forward = true;
+    return op;
+}
+
+/* assembly text */
+
+static const char *reg_names[4][16] = {
+    { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+      "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" },
+    { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+      "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" },
+    { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+      "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" },
+    { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+      "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" }
+};
+
+static const char *high_names[4] = { "ah", "ch", "dh", "bh" };
+
+static void write_str(text_t *text, const char *str) {
+    text_write(text, str, strlen(str));
+}
+
+static void write_reg(text_t *text, int reg, int size, bool high) {
+    TEXT_LIT(text, "%");
+    if(high) {
+        write_str(text, high_names[reg - 4]);
+    } else if(size >= 16) {
+        text_write(text, (size == 16) ? "xmm" : "ymm", 3);
+        text_uint(text, reg);
+    } else {
+        write_str(text, reg_names[(size == 8) ? 3 : (size == 4) ? 2 : (size == 2) ? 1 : 0][reg]);
+    }
+}
+
+/**
+ * writes a value relative to a symbol or numeric label, leaving out a
+ * zero displacement unless it is asked for or there is nothing else.
+ */
+static void write_value(text_t *text, const x86_op_t *op, bool address) {
+    bool relative = op->sym != NULL || op->local >= 0;
+    if(op->sym != NULL) {
+        write_str(text, op->sym);
+    } else if(op->local >= 0) {
+        text_uint(text, op->local);
+        text_write(text, op->forward ? "f" : "b", 1);
+    }
+
+    if(op->value == 0 && !op->disp && (relative || address)) return;
+    if(relative && op->value >= 0) TEXT_LIT(text, "+");
+    text_int(text, op->value);
+}
+
+static void write_operand(text_t *text, const x86_op_t *op) {
+    switch (op->kind) {
+    case X86_OP_REG:
+        write_reg(text, op->reg, op->size, op->high);
+        break;
+    case X86_OP_IMM:
+        TEXT_LIT(text, "$");
+        write_value(text, op, false);
+        break;
+    case X86_OP_MEM:
+        write_value(text, op, op->base >= 0 || op->index >= 0);
+        if(op->base < 0 && op->index < 0) break;
+
+        TEXT_LIT(text, "(");
+        if(op->base >= 0) write_reg(text, op->base, 8, false);
+        if(op->index >= 0) {
+            TEXT_LIT(text, ",");
+            write_reg(text, op->index, 8, false);
+            if(op->scale != 1) {
+                TEXT_LIT(text, ",");
+                text_int(text, op->scale);
+            }
+        }
+        TEXT_LIT(text, ")");
+        break;
+    }
+}
+
+static void write_ins(text_t *text, const mnemonic_t *m, int size, const x86_op_t *ops, int n) {
+    write_str(text, m->name);
+    if(m->sized && size != 0) text_write(text, &"?bw?l???q"[size], 1);
+
+    for(int i = 0; i < n; ++i) {
+        if(i == 0) TEXT_LIT(text, " ");
+        else TEXT_LIT(text, ", ");
+        write_operand(text, &ops[i]);
+    }
+    TEXT_LIT(text, "\n");
+}
+
+/* statements */
+
+static void resolve_operand(as_t *as, const x86_op_t *op, operand_t *out) {
+    *out = (operand_t) {
+        .kind = op->kind, .reg = op->reg, .size = op->size, .high = op->high,
+        .value = op->value, .sym = -1, .base = op->base, .index = op->index, .scale = op->scale
+    };
+
+    if(op->local >= X86_MAX_LOCAL) AS_ERROR("numeric label %d too large", op->local);
+
+    if(op->sym != NULL) out->sym = sym_get(as->obj, op->sym);
+    else if(op->local >= 0) out->sym = local_sym(as, op->local, as->locals[op->local] + op->forward);
+}
+
+void x86_ins(x86_as_t *as, x86_ins_e ins, int size, const x86_op_t *ops, int n) {
+    const mnemonic_t *m = &mnemonics[ins];
+    if(as->text != NULL) {
+        write_ins(as->text, m, size, ops, n);
+        return;
+    }
+
+    operand_t resolved[MAX_OPERANDS];
+    if(n > MAX_OPERANDS) AS_ERROR("too many operands");
+    for(int i = 0; i < n; ++i) resolve_operand(as, &ops[i], &resolved[i]);
+    m->handler(as, m->arg, size, resolved, n);
+}
+
+void x86_ins0(x86_as_t *as, x86_ins_e ins) {
+    x86_ins(as, ins, 0, NULL, 0);
+}
+
+void x86_ins1(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a) {
+    x86_ins(as, ins, size, &a, 1);
+}
+
+void x86_ins2(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a, x86_op_t b) {
+    x86_op_t ops[2] = { a, b };
+    x86_ins(as, ins, size, ops, 2);
+}
+
+void x86_ins3(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a, x86_op_t b, x86_op_t c) {
+    x86_op_t ops[3] = { a, b, c };
+    x86_ins(as, ins, size, ops, 3);
+}
+
+void x86_section(x86_as_t *as, x86_section_e section) {
+    as->section = section;
+    if(as->text == NULL) return;
+
+    TEXT_LIT(as->text, ".section ");
+    write_str(as->text, x86_section_names[section]);
+    TEXT_LIT(as->text, "\n");
+}
+
+void x86_global(x86_as_t *as, const char *name) {
+    if(as->text != NULL) {
+        TEXT_LIT(as->text, ".global ");
+        write_str(as->text, name);
+        TEXT_LIT(as->text, "\n");
+        return;
+    }
+
+    as->obj->syms[sym_get(as->obj, name)].global = true;
+}
+
+void x86_label(x86_as_t *as, const char *name) {
+    if(as->text != NULL) {
+        write_str(as->text, name);
+        TEXT_LIT(as->text, ":\n");
+        return;
+    }
+
+    define_label(as, sym_get(as->obj, name));
+}
+
+void x86_local(x86_as_t *as, unsigned n) {
+    if(as->text != NULL) {
+        text_uint(as->text, n);
+        TEXT_LIT(as->text, ":\n");
+        return;
+    }
+
+    if(n >= X86_MAX_LOCAL) AS_ERROR("numeric label %u too large", n);
+    define_label(as, local_sym(as, n, ++as->locals[n]));
+}
+
+// the recommended nops of one to nine bytes, which code is padded with so
+// that falling through the padding takes as few instructions as possible.
+static const unsigned char nops[9][9] = {
+    { 0x90 },
+    { 0x66, 0x90 },
+    { 0x0f, 0x1f, 0x00 },
+    { 0x0f, 0x1f, 0x40, 0x00 },
+    { 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+    { 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 },
+    { 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 },
+    { 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
+void x86_align(x86_as_t *as, uint64_t alignment) {
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0) AS_ERROR("invalid alignment");
+
+    if(as->text != NULL) {
+        unsigned bits = 0;
+        while(((uint64_t) 1 << bits) < alignment) bits++;
+        TEXT_LIT(as->text, ".p2align ");
+        text_uint(as->text, bits);
+        TEXT_LIT(as->text, "\n");
+        return;
+    }
+
+    x86_sec_t *sec = current(as);
+    if(alignment > sec->align) sec->align = alignment;
+
+    uint64_t pad = (alignment - sec->size % alignment) % alignment;
+    if(as->section != X86_TEXT) {
+        fill(as, pad, 0);
+        return;
+    }
+
+    while(pad > 0) {
+        unsigned n = (pad > 9) ? 9 : pad;
+        for(unsigned i = 0; i < n; ++i) emit8(as, nops[n - 1][i]);
+        pad -= n;
+    }
+}
+
+void x86_skip(x86_as_t *as, uint64_t n) {
+    if(as->text != NULL) {
+        TEXT_LIT(as->text, ".skip ");
+        text_uint(as->text, n);
+        TEXT_LIT(as->text, "\n");
+        return;
+    }
+
+    fill(as, n, 0);
+}
+
+void x86_bytes(x86_as_t *as, const unsigned char *bytes, size_t len) {
+    if(as->text != NULL) {
+        for(size_t i = 0; i < len; ++i) {
+            if(i % 16 == 0) TEXT_LIT(as->text, ".byte ");
+            else TEXT_LIT(as->text, ", ");
+            text_uint(as->text, bytes[i]);
+            if(i % 16 == 15 || i == len - 1) TEXT_LIT(as->text, "\n");
+        }
+        return;
+    }
+
+    if(as->section == X86_BSS) AS_ERROR("data in .bss");
+    reserve(as, len);
+    x86_sec_t *sec = current(as);
+    memcpy(sec->data + sec->size, bytes, len);
+    sec->size += len;
+}
+
+void x86_quad(x86_as_t *as, const x86_op_t *values, int n) {
+    if(as->text != NULL) {
+        TEXT_LIT(as->text, ".quad ");
+        for(int i = 0; i < n; i++) {
+            if(i > 0) TEXT_LIT(as->text, ", ");
+            write_value(as->text, &values[i], false);
+        }
+        TEXT_LIT(as->text, "\n");
+        return;
+    }
+
+    for(int i = 0; i < n; i++) {
+        const x86_op_t *v = &values[i];
+        int sym = (v->sym != NULL) ? (int) sym_get(as->obj, v->sym) : -1;
+        emit_value(as, v->value, sym, 8, X86_ABS64);
+    }
+}
+
+/**
+ * resolves the branches to labels in the same section that were defined
+ * after them, which do not depend on where the section is placed.
+ */
+static void resolve_local(x86_obj_t *obj) {
+    unsigned kept = 0;
+
+    for(unsigned i = 0; i < obj->reloc_count; ++i) {
+        x86_reloc_t *r = &obj->relocs[i];
+        x86_sym_t *s = &obj->syms[r->sym];
+
+        if(r->type == X86_PC32 && s->section == r->section) {
+            int64_t value = (int64_t) s->offset + r->addend - (int64_t) r->offset;
+            unsigned char *field = obj->sections[r->section].data + r->offset;
+            for(int j = 0; j < 4; ++j) field[j] = (value >> (8 * j)) & 0xff;
+            continue;
+        }
+
+        obj->relocs[kept++] = *r;
+    }
+
+    obj->reloc_count = kept;
+}
+
+void x86_begin(x86_as_t *as, x86_obj_t *obj) {
+    memset(obj, 0, sizeof *obj);
+    for(int i = 0; i < X86_SECTIONS; ++i) obj->sections[i].align = 1;
+    obj->sections[X86_TEXT].align = 16;
+
+    *as = (x86_as_t) { .obj = obj, .section = X86_TEXT };
+}
+
+void x86_begin_text(x86_as_t *as, text_t *text) {
+    *as = (x86_as_t) { .text = text, .section = X86_TEXT };
+}
+
+void x86_end(x86_as_t *as) {
+    if(as->obj != NULL) resolve_local(as->obj);
+}
+
+void x86_link(x86_obj_t *obj, const uint64_t base[X86_SECTIONS]) {
+    for(unsigned i = 0; i < obj->reloc_count; ++i) {
+        x86_reloc_t *r = &obj->relocs[i];
+        x86_sym_t *s = &obj->syms[r->sym];
+        if(s->section < 0) error("ld: undefined symbol '%s'", s->name);
+
+        int64_t value = (int64_t) (base[s->section] + s->offset) + r->addend;
+        if(r->type == X86_PC32) value -= (int64_t) (base[r->section] + r->offset);
+
+        bool fits = true;
+        int size = 4;
+        switch (r->type) {
+        case X86_ABS64: size = 8; break;
+        case X86_ABS32: fits = value >= 0 && value <= UINT32_MAX; break;
+        case X86_ABS32S:
+        case X86_PC32: fits = FITS32(value); break;
+        }
+        if(!fits) error("ld: relocation against '%s' out of range", s->name);
+
+        unsigned char *field = obj->sections[r->section].data + r->offset;
+        for(int j = 0; j < size; ++j) field[j] = ((uint64_t) value >> (8 * j)) & 0xff;
+    }
+}
+
+void x86_free(x86_obj_t *obj) {
+    for(int i = 0; i < X86_SECTIONS; ++i) free(obj->sections[i].data);
+    for(unsigned i = 0; i < obj->sym_count; ++i) free(obj->syms[i].name);
+    free(obj->syms);
+    free(obj->hash);
+    free(obj->relocs);
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2021 Olle Lögdahl
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "text.h"
+
+/**
+ * An assembler for the x86_64 instructions that bfc generates. They are
+ * given to it with their operands, and encoded into section contents,
+ * symbols and relocations, which can be linked in memory or written to an
+ * object file. For -S they are written out as GNU assembly instead.
+ */
+
+typedef enum {
+    X86_TEXT,
+    X86_RODATA,
+    X86_DATA,
+    X86_BSS,
+    X86_SECTIONS
+} x86_section_e;
+
+typedef enum {
+    X86_ABS64,      // S + A
+    X86_ABS32,      // S + A, zero extended
+    X86_ABS32S,     // S + A, sign extended
+    X86_PC32        // S + A - P
+} x86_reloc_e;
+
+typedef struct {
+    char *name;
+    int section;        // -1 while undefined
+    uint64_t offset;
+    bool global;
+    bool local_label;   // numeric labels, never exported
+} x86_sym_t;
+
+typedef struct {
+    int section;
+    uint64_t offset;
+    unsigned sym;
+    x86_reloc_e type;
+    int64_t addend;
+} x86_reloc_t;
+
+typedef struct {
+    unsigned char *data;    // NULL for .bss
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t align;
+} x86_sec_t;
+
+typedef struct {
+    x86_sec_t sections[X86_SECTIONS];
+
+    unsigned sym_count;
+    unsigned sym_capacity;
+    x86_sym_t *syms;
+
+    // open addressed index of the symbols by name.
+    unsigned hash_capacity;
+    unsigned *hash;
+
+    unsigned reloc_count;
+    unsigned reloc_capacity;
+    x86_reloc_t *relocs;
+} x86_obj_t;
+
+// the numeric labels 0: to 99: can be used.
+#define X86_MAX_LOCAL 100
+
+/**
+ * The state of assembling into an object, or of writing the assembly to
+ * text when text is set. The section and the numeric labels carry over
+ * from one instruction to the next.
+ */
+typedef struct {
+    x86_obj_t *obj;
+    text_t *text;
+    int section;
+
+    // the number of definitions of every numeric label seen so far.
+    unsigned locals[X86_MAX_LOCAL];
+} x86_as_t;
+
+extern const char *x86_section_names[X86_SECTIONS];
+
+// the general purpose registers, and the vector registers by the same
+// numbers. X86_NONE leaves out the base or index of an address.
+typedef enum {
+    X86_NONE = -1,
+    X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+    X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15
+} x86_reg_e;
+
+typedef enum {
+    X86_ADD, X86_AND, X86_SUB, X86_CMP, X86_MOV, X86_TEST, X86_NEG, X86_MUL,
+    X86_DIV, X86_IMUL, X86_INC, X86_DEC, X86_SHL, X86_SHR, X86_LEA,
+    X86_PUSH, X86_POP, X86_MOVZBL, X86_BSF, X86_BSR, X86_TZCNT,
+    X86_JMP, X86_CALL, X86_JB, X86_JAE, X86_JE, X86_JZ, X86_JNE, X86_JNZ,
+    X86_JBE, X86_JS, X86_JLE,
+    X86_RET, X86_SYSCALL, X86_VZEROUPPER, X86_REP_MOVSB, X86_REP_STOSB,
+    X86_PXOR, X86_PAND, X86_PADDB, X86_PADDW, X86_PCMPEQB, X86_PCMPEQW,
+    X86_PCMPEQD, X86_MOVDQU, X86_PMOVMSKB,
+    X86_VPXOR, X86_VPAND, X86_VPADDB, X86_VPADDW, X86_VPCMPEQB, X86_VPCMPEQW,
+    X86_VPCMPEQD, X86_VMOVDQU, X86_VPMOVMSKB,
+    X86_INSTRUCTIONS
+} x86_ins_e;
+
+/**
+ * An operand of an instruction. Symbols are referred to by name, and
+ * numeric labels as their previous or next definition.
+ */
+typedef struct {
+    enum {
+        X86_OP_REG,
+        X86_OP_IMM,
+        X86_OP_MEM
+    } kind;
+
+    // registers: the number, and the size in bytes. Vector registers are
+    // 16 (xmm) or 32 (ymm) bytes wide.
+    int reg;
+    int size;
+    bool high;
+
+    // immediates and displacements, optionally relative to a symbol or to
+    // a numeric label, which is -1 when absent.
+    int64_t value;
+    const char *sym;
+    int local;
+    bool forward;
+
+    // whether the assembly text writes the displacement even when it is
+    // zero, as in 0(%rdi).
+    bool disp;
+
+    // memory operands.
+    int base;
+    int index;
+    int scale;
+} x86_op_t;
+
+x86_op_t x86_reg(int reg, int size);
+
+/**
+ * %ah to %bh, the second byte of %rax to %rbx.
+ */
+x86_op_t x86_high(int reg);
+x86_op_t x86_imm(int64_t value);
+
+/**
+ * the address of a symbol, as an immediate.
+ */
+x86_op_t x86_imm_sym(const char *sym, int64_t value);
+
+/**
+ * memory at a register, or at a register plus a scaled index, with a
+ * displacement, or without one for x86_at and x86_at_index.
+ */
+x86_op_t x86_mem(int base, int64_t disp);
+x86_op_t x86_mem_index(int base, int index, int scale, int64_t disp);
+x86_op_t x86_at(int base);
+x86_op_t x86_at_index(int base, int index, int scale);
+
+/**
+ * the memory at a symbol, which is also how branches name their target,
+ * optionally relative to a base register.
+ */
+x86_op_t x86_sym(const char *sym, int64_t disp);
+x86_op_t x86_sym_base(const char *sym, int64_t disp, int base);
+
+/**
+ * the previous (back) or next (forward) definition of a numeric label.
+ */
+x86_op_t x86_back(unsigned n);
+x86_op_t x86_forward(unsigned n);
+
+/**
+ * starts assembling into an empty object, or writing assembly to text.
+ * Branches within a section are resolved by x86_end; everything else is
+ * left as relocations.
+ */
+void x86_begin(x86_as_t *as, x86_obj_t *obj);
+void x86_begin_text(x86_as_t *as, text_t *text);
+void x86_end(x86_as_t *as);
+
+/**
+ * adds an instruction, with its operands in the order of GNU assembly.
+ * size is the operand size in bytes given by the suffix, or 0 to take it
+ * from the register operands.
+ */
+void x86_ins(x86_as_t *as, x86_ins_e ins, int size, const x86_op_t *ops, int n);
+void x86_ins0(x86_as_t *as, x86_ins_e ins);
+void x86_ins1(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a);
+void x86_ins2(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a, x86_op_t b);
+void x86_ins3(x86_as_t *as, x86_ins_e ins, int size, x86_op_t a, x86_op_t b, x86_op_t c);
+
+void x86_section(x86_as_t *as, x86_section_e section);
+void x86_global(x86_as_t *as, const char *name);
+void x86_label(x86_as_t *as, const char *name);
+
+/**
+ * defines a numeric label, once more.
+ */
+void x86_local(x86_as_t *as, unsigned n);
+
+/**
+ * pads the section to a power of two, with nops in code.
+ */
+void x86_align(x86_as_t *as, uint64_t alignment);
+void x86_skip(x86_as_t *as, uint64_t n);
+void x86_bytes(x86_as_t *as, const unsigned char *bytes, size_t len);
+
+/**
+ * 64 bit values, given as immediates which may be relative to a symbol.
+ */
+void x86_quad(x86_as_t *as, const x86_op_t *values, int n);
+
+/**
+ * applies all relocations given the address every section is placed at.
+ * The section contents are patched in place.
+ */
+void x86_link(x86_obj_t *obj, const uint64_t base[X86_SECTIONS]);
+
+/**
+ * returns the index of a symbol, or -1 if it does not exist.
+ */
+int x86_find(x86_obj_t *obj, const char *name);
+
+void x86_free(x86_obj_t *obj);
@@ -0,0 +1,6 @@
+tests that folded pointer moves land on the right cells
+reads into 1 and 3 then moves around them in straight lines before printing
+
+>,>>,<<<
+>+>>-<<<+>>>>+<<
+<.>>.<<<.>>>>.
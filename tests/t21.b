@@ -0,0 +1,14 @@
+tests balanced loops with repeated visits and odd control steps
+
+,>,>,<<
+[>+>++<<-]      1 plus 0 and 2 plus twice 0
+>>.<.<
++++++
+[->+<>>-<<]     1 plus 0 and 2 minus 0
+>.>.<<
+++++++
+[--->+<]        1 plus 0 divided by 3
+>.<
++
+[--->+<]        1 plus 171
+>.
@@ -0,0 +1,6 @@
+prints a computed character and then echoes two characters from a loop
+the prefix up to the first read is evaluated while compiling
+
+++++++[>+++++<-]>+++.
+[-]++[>,.<-]
+>+.
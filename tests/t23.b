@@ -0,0 +1,11 @@
+walks 20000 cells to the right in steps of one cell carrying two
+counters then 40000 cells to the left and back to the start
+printing a letter at each end
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[->++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-[->+<]<[->+<]>>]<]
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-<++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-[-<+>]>[-<+>]<<]>]
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-<++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-[-<+>]>[-<+>]<<]>]
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[->++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[-[->+<]<[->+<]>>]<]
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.
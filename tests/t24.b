@@ -0,0 +1,9 @@
+tests 16 bit cells which wrap around at 65536 and print their
+lowest byte
+
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.          321 prints as 65
+[-]-[->+<]>.            0 minus 1 is 65535 which prints as 255
+[---<+>]<.              65535 is 21845 times 3 so 21845 prints as 85
+[-],.                   reads a byte
+[-]++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[>+<-]>[>+<-]>[<<+>>[-]]<<.
+                        256 is not zero so this prints 1
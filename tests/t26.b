@@ -0,0 +1,11 @@
+tests cells kept in registers through straight line code
+
+reads a byte and copies it into the next eight cells
+,[->+>+>+>+>+>+>+>+<<<<<<<<]
+uses the cells again and again and prints them
+>+.>++.>+++.>++++.>+++++.>++++++.>+++++++.>++++++++.
+<<<<<<<-.>-.>>>>>>+.<<<+.
+adds three cells to the one before them and prints it
+[-<+>]>[-<<+>>]>[-<<<+>>>]<<<.
+runs a loop tested on a cell kept in a register
+>>>>[-]+++[<+.>-]<.
@@ -0,0 +1,16 @@
+tests folding stores to the same cell in straight line code
+
+reads a byte so the rest runs at run time
+,
+adds to a cell and clears it then adds the digit one
+>+++[-]+++++++++++++++++++++++++++++++++++++++++++++++++.
+clears a cell then adds the digit five
+>[-]+++++++++++++++++++++++++++++++++++++++++++++++++++++.
+clears the same cell twice with another one cleared in between
+>[-]>[-]<[-]++++++++++++++++++++++++++++++++++++++++++++++++++.
+moves that cancel out around adds that cancel out
+>+<>-<>>+<<+>>-<<.
+copies a cell into two others and adds one to the first after the copy
+<<<[->>>>+>+<<<<<]>>>>+.>.
+prints a cell and then overwrites it
+++.[-]++++++++++++++++++++++++++++++++++++++++++++++++++++.
@@ -0,0 +1,4 @@
+tests that a store before a read at end of input is dropped only when
+the read sets the cell
+
+,+++,++++++++++++++++++++++++++++++++++++++++++++++++.
@@ -0,0 +1,12 @@
+tests loops laid out by a profile made from the first scenario
+
+reads a byte and subtracts the letter a from it
+,>++++++[<---------------->-]<-
+prints A unless the byte was the letter a
+this loop never runs in the profile and is moved out of line
+[>>++++++++[>++++++++<-]>+.[-]<<[-]]
+sets up three lines and the star and newline characters
+>>>+++>++++++[>+++++++<-]>>++++++++++<<<
+prints three lines of five stars
+the inner loop is short and runs five times so it is unrolled
+[>+++++[>.<-]>>.<<<-]
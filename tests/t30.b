@@ -0,0 +1,6 @@
+tests a program compiled as a stream in parts of two tokens: a part
+may not assume a blank tape at its start or drop the moves at its end
+
+++++++++[>++++++<-]>+ >+++
+[<.>-] <+. >
+[.] ++++++++++.
@@ -0,0 +1,12 @@
+tests updates of adjacent cells that fill vectors
+
+reads a byte
+,
+changes the twenty cells after it with a mix of adds and sets
+>+>++>[-]+++++++++++++++++++++++>->[-]+++++++++++++++++++++++++++++++++>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+++
+<<<<<<<<<<<<<<<<<<<<
+adds the byte to each of them
+[->+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+<<<<<<<<<<<<<<<<<<<<]
+
+writes them all
+>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.>.
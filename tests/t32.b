@@ -0,0 +1,8 @@
+tests the loops and the iterations of each that the report counts
+
+reads how often the first loop runs
+,
+each time runs a loop that writes four bytes
+[>++++[.-]<-]
+then reads and writes three bytes in a loop
+>>+++[<<,[.[-]]>>-]